@@ -0,0 +1,435 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef URI_PATH_FINDER_BENCH_H
+#define URI_PATH_FINDER_BENCH_H
+
+/* Shared harness for the benchmarks.  Each benchmark builds a few
+ * corpora of inputs, runs an operation over every input of a corpus
+ * for a number of rounds, and prints one JSON object per line:
+ *
+ *   {"bench": ..., "corpus": ..., "op": ..., "simd": ..., "inputs": ..., "bytes": ...,
+ *    "ns_per_input": ..., "bytes_per_cycle": ...,
+ *    "p50_ns": ..., "p90_ns": ..., "p99_ns": ..., "p999_ns": ...,
+ *    "cycles": ..., "instructions": ..., "branch_misses": ...,
+ *    "l1d_misses": ...}
+ *
+ * Cycles for bytes_per_cycle are TSC reference cycles where available.
+ * The percentiles come from timing every input individually.  The
+ * counters are per input, read with perf_event_open on Linux around a
+ * separate untimed pass, and are null where the kernel does not allow
+ * them.  Each corpus is reported as a whole with "bucket": "all" and
+ * again split into buckets by input length.  "simd" is the level of the
+ * scans in use, see simd.h, which make SIMD=... picks to compare them. */
+
+#define _POSIX_C_SOURCE 200809L
+/* For syscall(2) */
+#define _DEFAULT_SOURCE
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "simd.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define BENCH_HAVE_PERF 1
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#endif
+
+#define BENCH_ROUNDS 5
+
+typedef unsigned long (*bench_fn)(const char *);
+
+typedef struct corpus {
+    const char *name;
+    size_t n;
+    size_t size;
+    size_t bytes;
+    size_t used;
+    size_t capacity;
+    const char **items;
+    char *storage;
+} corpus;
+
+/* Keeps the compiler from discarding the work being measured */
+static volatile unsigned long bench_sink = 0;
+
+static unsigned long bench_state = 88172645463325252UL;
+
+/* xorshift, so the corpora are the same on every run */
+static unsigned long bench_rand(void) {
+    bench_state ^= bench_state << 13;
+    bench_state ^= bench_state >> 7;
+    bench_state ^= bench_state << 17;
+    return bench_state;
+}
+
+static unsigned long bench_range(unsigned long lo, unsigned long hi) {
+    return lo + bench_rand() % (hi - lo + 1);
+}
+
+static double bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static unsigned long long bench_ticks(void) {
+#ifdef BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return (unsigned long long)bench_now_ns();
+#endif
+}
+
+static void corpus_init(corpus *c, const char *name, size_t size, size_t capacity) {
+    c->name = name;
+    c->n = 0;
+    c->size = size;
+    c->bytes = 0;
+    c->used = 0;
+    c->capacity = capacity;
+    c->items = malloc(size * sizeof(c->items[0]));
+    c->storage = malloc(capacity);
+    if (c->items == NULL || c->storage == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+}
+
+static void corpus_free(corpus *c) {
+    free(c->items);
+    free(c->storage);
+}
+
+/* Add a printf formatted input; returns 0 once the corpus is full */
+static int corpus_add(corpus *c, const char *fmt, ...) {
+    va_list ap;
+    int len = 0;
+    if (c->n == c->size) {
+        return 0;
+    }
+    va_start(ap, fmt);
+    len = vsnprintf(&c->storage[c->used], c->capacity - c->used, fmt, ap);
+    va_end(ap);
+    if (len < 0 || (size_t)len >= c->capacity - c->used) {
+        return 0;
+    }
+    c->items[c->n++] = &c->storage[c->used];
+    c->used += len + 1;
+    c->bytes += len;
+    return 1;
+}
+
+/* Append random characters from the set to a buffer */
+static char *bench_fill(char *buf, size_t len, const char *set) {
+    size_t set_len = strlen(set);
+    size_t i = 0;
+    for (i = 0; i < len; i++) {
+        buf[i] = set[bench_rand() % set_len];
+    }
+    buf[len] = '\0';
+    return buf;
+}
+
+static int bench_compare(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *)a;
+    unsigned long long y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+enum {
+    BENCH_CYCLES,
+    BENCH_INSTRUCTIONS,
+    BENCH_BRANCH_MISSES,
+    BENCH_L1D_MISSES,
+    BENCH_COUNTERS
+};
+
+static const char *bench_counter_names[BENCH_COUNTERS] = {
+    "cycles", "instructions", "branch_misses", "l1d_misses",
+};
+
+/* perf_event_open file descriptors, -1 where unavailable */
+static int bench_fds[BENCH_COUNTERS] = { -2, -2, -2, -2 };
+
+static void bench_counters_open(void) {
+#ifdef BENCH_HAVE_PERF
+    static const struct {
+        unsigned int type;
+        unsigned long long config;
+    } events[BENCH_COUNTERS] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                              (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    };
+    size_t i = 0;
+    for (i = 0; i < BENCH_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        bench_fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#else
+    size_t i = 0;
+    for (i = 0; i < BENCH_COUNTERS; i++) {
+        bench_fds[i] = -1;
+    }
+#endif
+}
+
+/* Run every input through f for each round and read the counters */
+static void bench_count(const char **items, size_t n, bench_fn f, long long counts[BENCH_COUNTERS]) {
+    unsigned long sink = 0;
+    size_t i = 0;
+    size_t r = 0;
+    if (bench_fds[0] == -2) {
+        bench_counters_open();
+    }
+#ifdef BENCH_HAVE_PERF
+    for (i = 0; i < BENCH_COUNTERS; i++) {
+        if (bench_fds[i] >= 0) {
+            ioctl(bench_fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(bench_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+    for (r = 0; r < BENCH_ROUNDS; r++) {
+        for (i = 0; i < n; i++) {
+            sink += f(items[i]);
+        }
+    }
+    for (i = 0; i < BENCH_COUNTERS; i++) {
+        counts[i] = -1;
+#ifdef BENCH_HAVE_PERF
+        if (bench_fds[i] >= 0) {
+            unsigned long long value = 0;
+            ioctl(bench_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(bench_fds[i], &value, sizeof(value)) == sizeof(value)) {
+                counts[i] = value;
+            }
+        }
+#endif
+    }
+    bench_sink += sink;
+}
+
+static void bench_measure(const char *bench, const char *name, const char *bucket, const char *op,
+                          const char **items, size_t n, size_t bytes, bench_fn f) {
+    size_t samples = n * BENCH_ROUNDS;
+    unsigned long long *ticks = malloc(samples * sizeof(ticks[0]));
+    unsigned long long total_ticks = 0;
+    long long counts[BENCH_COUNTERS];
+    unsigned long sink = 0;
+    double start = 0;
+    double ns = 0;
+    double ns_per_tick = 0;
+    size_t i = 0;
+    size_t r = 0;
+    if (ticks == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    /* Warm up the caches and branch predictors */
+    for (i = 0; i < n; i++) {
+        sink += f(items[i]);
+    }
+    start = bench_now_ns();
+    for (r = 0; r < BENCH_ROUNDS; r++) {
+        for (i = 0; i < n; i++) {
+            unsigned long long t0 = bench_ticks();
+            sink += f(items[i]);
+            ticks[r * n + i] = bench_ticks() - t0;
+        }
+    }
+    ns = bench_now_ns() - start;
+    bench_sink += sink;
+    bench_count(items, n, f, counts);
+    for (i = 0; i < samples; i++) {
+        total_ticks += ticks[i];
+    }
+    ns_per_tick = total_ticks ? ns / total_ticks : 0;
+    qsort(ticks, samples, sizeof(ticks[0]), bench_compare);
+    printf("{\"bench\": \"%s\", \"corpus\": \"%s\", \"bucket\": \"%s\", \"op\": \"%s\", "
+           "\"simd\": \"%s\", \"inputs\": %lu, \"bytes\": %lu, "
+           "\"ns_per_input\": %.2f, \"bytes_per_cycle\": %.4f, "
+           "\"p50_ns\": %.1f, \"p90_ns\": %.1f, \"p99_ns\": %.1f, \"p999_ns\": %.1f",
+           bench, name, bucket, op, simd_level_name(simd_get_level()),
+           (unsigned long)n, (unsigned long)bytes,
+           ns / samples,
+           total_ticks ? (double)bytes * BENCH_ROUNDS / total_ticks : 0,
+           ticks[samples * 50 / 100] * ns_per_tick,
+           ticks[samples * 90 / 100] * ns_per_tick,
+           ticks[samples * 99 / 100] * ns_per_tick,
+           ticks[samples * 999 / 1000] * ns_per_tick);
+    for (i = 0; i < BENCH_COUNTERS; i++) {
+        if (counts[i] < 0) {
+            printf(", \"%s\": null", bench_counter_names[i]);
+        } else {
+            printf(", \"%s\": %.1f", bench_counter_names[i], (double)counts[i] / samples);
+        }
+    }
+    printf("}\n");
+    fflush(stdout);
+    free(ticks);
+}
+
+/* Input length buckets; the last one is open ended */
+static const size_t bench_buckets[] = { 0, 32, 64, 128, 256, 512, 1024 };
+
+#define BENCH_BUCKETS (sizeof(bench_buckets) / sizeof(bench_buckets[0]))
+
+static void bench_run(const char *bench, const corpus *c, const char *op, bench_fn f) {
+    const char **items = malloc(c->n * sizeof(items[0]) + 1);
+    size_t b = 0;
+    if (items == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    if (c->n > 0) {
+        bench_measure(bench, c->name, "all", op, c->items, c->n, c->bytes, f);
+    }
+    for (b = 0; b < BENCH_BUCKETS; b++) {
+        size_t lo = bench_buckets[b];
+        size_t hi = b + 1 < BENCH_BUCKETS ? bench_buckets[b + 1] : (size_t)-1;
+        size_t n = 0;
+        size_t bytes = 0;
+        size_t i = 0;
+        char label[32];
+        for (i = 0; i < c->n; i++) {
+            size_t len = strlen(c->items[i]);
+            if (len >= lo && len < hi) {
+                items[n++] = c->items[i];
+                bytes += len;
+            }
+        }
+        /* A bucket holding the whole corpus would repeat the line above */
+        if (n == 0 || n == c->n) {
+            continue;
+        }
+        if (hi == (size_t)-1) {
+            sprintf(label, "%lu+", (unsigned long)lo);
+        } else {
+            sprintf(label, "%lu-%lu", (unsigned long)lo, (unsigned long)hi - 1);
+        }
+        bench_measure(bench, c->name, label, op, items, n, bytes, f);
+    }
+    free(items);
+}
+
+/* Inputs for the scaling check grow from 2^BENCH_SCALE_MIN to
+ * 2^BENCH_SCALE_MAX bytes.  Time per byte may drift with cache effects,
+ * but superlinear parsing grows it by the same factor as the input. */
+#define BENCH_SCALE_MIN 8
+#define BENCH_SCALE_MAX 16
+#define BENCH_SCALE_SLACK 4.0
+
+/* Check that f takes time linear in the length of prefix unit* suffix.
+ * Prints one line per length, then one with the ratio of the time per
+ * byte at the longest length to the lowest time per byte; returns 0 if
+ * that ratio is within BENCH_SCALE_SLACK. */
+static int bench_scaling(const char *bench, const char *name, const char *op,
+                         const char *prefix, const char *unit, const char *suffix, bench_fn f) {
+    size_t cap = ((size_t)1 << BENCH_SCALE_MAX) + strlen(prefix) + strlen(unit) + strlen(suffix) + 1;
+    char *buf = malloc(cap);
+    double lowest = 0;
+    double last = 0;
+    double ratio = 0;
+    int scale = 0;
+    if (buf == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    for (scale = BENCH_SCALE_MIN; scale <= BENCH_SCALE_MAX; scale++) {
+        size_t target = (size_t)1 << scale;
+        size_t len = strlen(prefix);
+        size_t reps = ((size_t)1 << 17) / target;
+        double best = 0;
+        size_t r = 0;
+        size_t i = 0;
+        strcpy(buf, prefix);
+        while (len + strlen(unit) + strlen(suffix) <= target) {
+            strcpy(&buf[len], unit);
+            len += strlen(unit);
+        }
+        strcpy(&buf[len], suffix);
+        len += strlen(suffix);
+        for (r = 0; r < BENCH_ROUNDS; r++) {
+            unsigned long sink = 0;
+            double start = bench_now_ns();
+            double ns = 0;
+            for (i = 0; i < reps; i++) {
+                sink += f(buf);
+            }
+            ns = (bench_now_ns() - start) / reps / len;
+            bench_sink += sink;
+            if (r == 0 || ns < best) {
+                best = ns;
+            }
+        }
+        if (scale == BENCH_SCALE_MIN || best < lowest) {
+            lowest = best;
+        }
+        last = best;
+        printf("{\"bench\": \"%s\", \"corpus\": \"%s\", \"op\": \"%s\", "
+               "\"bytes\": %lu, \"ns_per_byte\": %.3f}\n",
+               bench, name, op, (unsigned long)len, best);
+    }
+    ratio = lowest > 0 ? last / lowest : 0;
+    printf("{\"bench\": \"%s\", \"corpus\": \"%s\", \"op\": \"%s\", "
+           "\"scaling_ratio\": %.2f, \"linear\": %s}\n",
+           bench, name, op, ratio, ratio <= BENCH_SCALE_SLACK ? "true" : "false");
+    fflush(stdout);
+    free(buf);
+    return ratio > BENCH_SCALE_SLACK;
+}
+
+#endif /* URI_PATH_FINDER_BENCH_H */
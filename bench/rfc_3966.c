@@ -0,0 +1,127 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rfc_3966.h"
+#include "bench.h"
+
+#define CORPUS_SIZE 20000
+
+static void make_global(corpus *c) {
+    corpus_init(c, "global", CORPUS_SIZE, CORPUS_SIZE * 32);
+    while (corpus_add(c, "tel:+1-%03lu-%03lu-%04lu",
+                      bench_range(200, 999), bench_range(200, 999), bench_range(0, 9999)));
+}
+
+static void make_local(corpus *c) {
+    corpus_init(c, "local", CORPUS_SIZE, CORPUS_SIZE * 64);
+    while (corpus_add(c, bench_rand() % 2 ? "tel:%03lu-%04lu;phone-context=example.com"
+                                          : "tel:%03lu-%04lu;phone-context=+1-914-555",
+                      bench_range(200, 999), bench_range(0, 9999)));
+}
+
+static void make_params(corpus *c) {
+    corpus_init(c, "params", CORPUS_SIZE, CORPUS_SIZE * 160);
+    while (corpus_add(c, "tel:+1-%03lu-%03lu-%04lu;ext=%lu;isub=%lu;npdi;rn=+1-%03lu-%03lu;cic=+1-%lu;foo=bar;x-tag=%lu",
+                      bench_range(200, 999), bench_range(200, 999), bench_range(0, 9999),
+                      bench_range(1, 9999), bench_range(1, 99999), bench_range(200, 999),
+                      bench_range(200, 999), bench_range(1000, 9999), bench_range(1, 999999)));
+}
+
+/* Inputs that are valid right up until the last few characters */
+static void make_invalid_late(corpus *c) {
+    static const char *tails[] = { " ", ";foo= bar", ";ext=1;ext=2", ";phone-context=example.com", "!" };
+    corpus_init(c, "invalid_late", CORPUS_SIZE / 2, CORPUS_SIZE / 2 * 96);
+    while (corpus_add(c, "tel:+1-%03lu-%03lu-%04lu;isub=%lu;foo=bar%s",
+                      bench_range(200, 999), bench_range(200, 999), bench_range(0, 9999),
+                      bench_range(1, 99999), tails[bench_rand() % 5]));
+}
+
+/* The floor for anything that reads the whole input */
+static unsigned long op_strlen(const char *s) {
+    return (unsigned long)strlen(s);
+}
+
+static unsigned long op_valid(const char *s) {
+    return (unsigned long)is_valid_telephone(s, strlen(s));
+}
+
+static unsigned long op_parse(const char *s) {
+    Tel t = parse_telephone(s);
+    return (unsigned long)(t.number_stop - s);
+}
+
+static unsigned long op_parse_len(const char *s) {
+    Tel t = parse_telephone(s);
+    return len_global_number(&t) + len_local_number(&t) + len_par_ext(&t) +
+           len_par_isdn(&t) + len_par_context(&t) + len_pars(&t);
+}
+
+/* Long runs of the characters that the ambiguous rules backtrack over */
+static const char *adversarial[][4] = {
+    /* name                 prefix                    unit      suffix */
+    { "semicolons",         "tel:+1",                 ";",      ""      },
+    { "empty_pars",         "tel:+1;a",               ";",      ""      },
+    { "duplicate_pars",     "tel:+1",                 ";a=1",   ""      },
+    { "context_dots",       "tel:1;phone-context=",   "1.",     "1"     },
+    { "context_dashes",     "tel:1;phone-context=",   "a-",     "-"     },
+    { "context_digits",     "tel:1;phone-context=+",  "-",      ""      },
+    { "ext_separators",     "tel:+1;ext=",            "1-",     "x"     },
+    { "rn_separators",      "tel:+1;rn=+1",           "f.",     "!"     },
+    { "number_separators",  "tel:+",                  ".",      "1"     },
+    { "pname_dashes",       "tel:+1;",                "a-",     "="     },
+    { "isub_uric",          "tel:+1;isub=",           "%41",    "\""    },
+};
+
+int main()
+{
+    int superlinear = 0;
+    void (*makers[])(corpus *) = {
+        make_global, make_local, make_params, make_invalid_late,
+    };
+    size_t i = 0;
+    for (i = 0; i < sizeof(makers) / sizeof(makers[0]); i++) {
+        corpus c;
+        makers[i](&c);
+        bench_run("rfc_3966", &c, "strlen", op_strlen);
+        bench_run("rfc_3966", &c, "parse_telephone", op_parse);
+        bench_run("rfc_3966", &c, "is_valid_telephone", op_valid);
+        bench_run("rfc_3966", &c, "parse_telephone+len_*", op_parse_len);
+        corpus_free(&c);
+    }
+    for (i = 0; i < sizeof(adversarial) / sizeof(adversarial[0]); i++) {
+        superlinear |= bench_scaling("rfc_3966", adversarial[i][0], "parse_telephone",
+                                     adversarial[i][1], adversarial[i][2], adversarial[i][3], op_parse);
+        superlinear |= bench_scaling("rfc_3966", adversarial[i][0], "is_valid_telephone",
+                                     adversarial[i][1], adversarial[i][2], adversarial[i][3], op_valid);
+    }
+    return superlinear;
+}
@@ -0,0 +1,93 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef URI_PATH_FINDER_ARENA_H
+#define URI_PATH_FINDER_ARENA_H
+
+#include <stddef.h>
+
+#include "rfc_3986.h"
+
+/* Owned storage for parsed URIs, for callers that keep URIs around
+ * after the buffer they were read into is reused.
+ *
+ * parse_URI_into_arena parses in place first, and only copies a valid
+ * URI, once, into the arena, returning the URI struct rebased to point
+ * into the copy.  The arena hands out space by bumping a pointer through
+ * chunks it allocates, so a copy costs a memcpy, and a malloc only when
+ * a chunk fills up.  Nothing is freed on its own: URI_arena_reset makes
+ * all the space reusable at once, keeping the chunks for the next round,
+ * and URI_arena_free gives them back.
+ *
+ * An arena isn't locked, so each thread should use its own, such as the
+ * one URI_thread_arena returns. */
+
+typedef struct URI_arena_chunk URI_arena_chunk;
+
+typedef struct URI_arena {
+    size_t chunk_size;
+    URI_arena_chunk *chunks;    /* in order, kept over resets */
+    URI_arena_chunk *current;   /* the one being bumped through */
+    char *next;
+    char *end;
+    size_t used;
+} URI_arena;
+
+/* Chunks are chunk_size bytes, or URI_ARENA_CHUNK_SIZE for 0.  A URI
+ * longer than that gets a chunk of its own. */
+#define URI_ARENA_CHUNK_SIZE 65536
+void URI_arena_init(URI_arena *, size_t chunk_size);
+
+/* Copies len bytes into the arena, NULL terminated.
+ * Returns NULL if a chunk couldn't be allocated. */
+char *URI_arena_copy(URI_arena *, const char *, size_t len);
+
+/* As parse_URI, but the URI points into a copy in the arena.  If the
+ * URI is invalid nothing is copied, and if a chunk couldn't be
+ * allocated all fields of the URI are NULL as for an invalid one. */
+URI parse_URI_into_arena(URI_arena *, const char *);
+
+/* The bytes handed out since the last reset */
+size_t URI_arena_used(const URI_arena *);
+
+/* Makes all the space reusable, so every URI in the arena is gone */
+void URI_arena_reset(URI_arena *);
+
+/* Frees every chunk; the arena can be used again as if just initialized */
+void URI_arena_free(URI_arena *);
+
+/* The calling thread's own arena, initialized with the default chunk
+ * size on first use.  A thread should free it before it exits. */
+URI_arena *URI_thread_arena(void);
+
+#endif /* URI_PATH_FINDER_ARENA_H */
@@ -0,0 +1,64 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef URI_PATH_FINDER_CHARSET_H
+#define URI_PATH_FINDER_CHARSET_H
+
+/* The characters the grammars accept as ALPHA and DIGIT.
+ *
+ * RFC 3986 and RFC 3966 only allow ASCII, which is what parse_URI and
+ * parse_telephone handle.  parse_URI_charset and parse_telephone_charset
+ * take one of these to accept more.  The grammars are compiled once for
+ * each of ASCII, UTF-8 and custom character sets, so ASCII and UTF-8
+ * parse without calling through a function pointer.
+ *
+ * A custom charset is only in effect for the call it's passed to, on
+ * the calling thread, so different threads can use different ones at
+ * the same time, and a parser in one can itself parse with another. */
+
+/* Like the grammar rules, these return a pointer to the character and
+ * advance the argument past it if found, or return NULL and don't
+ * advance if not. */
+typedef const char *(*charset_parser)(const char **);
+
+typedef struct charset {
+    charset_parser alpha;   /* NULL for ASCII letters */
+    charset_parser digit;   /* NULL for ASCII digits */
+} charset;
+
+/* ASCII, the same as passing NULL */
+extern const charset charset_ascii;
+
+/* ASCII, and every well-formed multi-byte UTF-8 sequence as a letter */
+extern const charset charset_utf8;
+
+#endif /* URI_PATH_FINDER_CHARSET_H */
@@ -0,0 +1,72 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef URI_PATH_FINDER_IDNA_H
+#define URI_PATH_FINDER_IDNA_H
+
+#include <stddef.h>
+
+#include "rfc_3986.h"
+
+/* Conversion of reg-name hosts between their Unicode form and the ACE
+ * form of IDNA (RFC 5890), where each non-ASCII label is written as
+ * "xn--" followed by its Punycode (RFC 3492).
+ *
+ * Most hosts are ASCII with no "xn--" labels, and are the same in both
+ * forms.  That's checked first, 16 bytes at a time, and such a host is
+ * just copied.  Only the labels that need it are converted.
+ *
+ * This is the Punycode step of IDNA only.  There's no case mapping or
+ * normalization (UTS 46), so labels should already be lowercase NFC.
+ *
+ * The results go into the caller's buffer, as for the get_* functions
+ * in rfc_3986.h: if it's too small, NULL is returned and the length is
+ * set to what's needed, excluding the NULL terminating byte.  If the
+ * host can't be converted, NULL is returned and the length is set to
+ * 0. */
+
+/* The len bytes at host to ACE form.  Non-ASCII labels may be UTF-8,
+ * as from parse_IRI, or pct-encoded UTF-8, as from IRI_to_URI.  A host
+ * with invalid UTF-8 or a label over 63 bytes once converted can't be
+ * converted. */
+char *host_to_ascii(const char *host, size_t len, char *buf, size_t *buf_len);
+
+/* The len bytes at host to Unicode form, with each "xn--" label decoded
+ * into UTF-8.  A host with a "xn--" label that isn't valid Punycode
+ * can't be converted. */
+char *host_to_unicode(const char *host, size_t len, char *buf, size_t *buf_len);
+
+/* The host of a parsed URI or IRI, converted as above */
+char *get_host_ascii(const URI *, char *, size_t *);
+char *get_host_unicode(const URI *, char *, size_t *);
+
+#endif /* URI_PATH_FINDER_IDNA_H */
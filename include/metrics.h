@@ -0,0 +1,113 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef URI_PATH_FINDER_METRICS_H
+#define URI_PATH_FINDER_METRICS_H
+
+#include <stddef.h>
+
+/* Latency histograms and success and failure counters for parse_URI
+ * and parse_telephone, for export to a monitoring system.
+ *
+ * Nothing is recorded until metrics_enable(1) is called; until then
+ * each parse pays for one test of a flag.  Once enabled, each thread
+ * records into its own slot without locks or atomic read-modify-writes,
+ * and metrics_snapshot sums the slots of every thread that has parsed
+ * so far.  A slot is given back when its thread exits, keeping its
+ * counts for the next thread to take it, so thread pools that churn
+ * don't run out of them; past 32 threads at once the rest share one
+ * slot, with atomic adds.  Counters only ever increase, so rates come
+ * from the difference of two snapshots.
+ *
+ * Parses are keyed by scheme and by the number of characters read,
+ * which for a failed parse is up to where it failed.  Latencies go into
+ * log-linear histograms with four bins per power of two nanoseconds. */
+
+typedef enum metrics_scheme {
+    METRICS_OTHER,      /* any other scheme, or none found */
+    METRICS_HTTP,
+    METRICS_HTTPS,
+    METRICS_WS,
+    METRICS_WSS,
+    METRICS_FTP,
+    METRICS_FILE,
+    METRICS_MAILTO,
+    METRICS_URN,
+    METRICS_DATA,
+    METRICS_TEL,        /* parse_telephone */
+    METRICS_SCHEMES
+} metrics_scheme;
+
+/* Where a parse failed */
+typedef enum metrics_reason {
+    METRICS_FAIL_SCHEME,        /* no scheme, or not "tel:" */
+    METRICS_FAIL_COLON,         /* the scheme isn't followed by ":" */
+    METRICS_FAIL_AUTHORITY,     /* stopped in the authority */
+    METRICS_FAIL_PATH,          /* stopped in the path */
+    METRICS_FAIL_QUERY,         /* stopped in the query */
+    METRICS_FAIL_FRAGMENT,      /* stopped in the fragment */
+    METRICS_FAIL_NUMBER,        /* no valid telephone number */
+    METRICS_FAIL_PARAMETERS,    /* the telephone number's parameters are invalid */
+    METRICS_FAIL_END,           /* the telephone number is followed by more */
+    METRICS_REASONS
+} metrics_reason;
+
+#define METRICS_LENGTHS 8   /* up to 15, 31, ..., 1023 characters, and more */
+#define METRICS_BINS 64     /* under 64ns, then four per power of two */
+
+typedef struct metrics_snapshot {
+    unsigned long successes[METRICS_SCHEMES][METRICS_LENGTHS];
+    unsigned long failures[METRICS_SCHEMES][METRICS_REASONS];
+    unsigned long latency[METRICS_SCHEMES][METRICS_LENGTHS][METRICS_BINS];
+} metrics_snapshot;
+
+/* Turn recording on or off for all threads */
+void metrics_enable(int on);
+
+/* Sum the counters of every thread into snapshot */
+void metrics_snapshot_take(metrics_snapshot *snapshot);
+
+/* Names for labels, e.g. "https", "path", and the exclusive upper
+ * bounds of the length buckets and histogram bins, which are
+ * (size_t)-1 and ~0ULL for the last ones. */
+const char *metrics_scheme_name(metrics_scheme scheme);
+const char *metrics_reason_name(metrics_reason reason);
+size_t metrics_length_upper(unsigned int length);
+unsigned long long metrics_bin_upper(unsigned int bin);
+
+/* Used by the parsers */
+extern int metrics_enabled;
+unsigned long long metrics_now(void);
+void metrics_record(metrics_scheme scheme, size_t length, int reason, unsigned long long start);
+metrics_scheme metrics_scheme_of(const char *scheme, size_t len);
+
+#endif /* URI_PATH_FINDER_METRICS_H */
@@ -0,0 +1,68 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef URI_PATH_FINDER_PROFILE_H
+#define URI_PATH_FINDER_PROFILE_H
+
+#include <stdio.h>
+
+/* Counters for each grammar rule, for finding where alternatives fail
+ * and how much backtracking real inputs cause.
+ *
+ * They are only kept when the library is built with URI_PROFILE
+ * defined (make PROFILE=1); otherwise the rules are compiled exactly as
+ * before and nothing is counted.  Each parse_* rule of RFC 3986 and
+ * RFC 3966 and each combinator gets one entry, added the first time it
+ * runs.  Counting is safe from multiple threads. */
+
+typedef struct profile_rule {
+    const char *name;
+    const char *file;
+    unsigned long successes;
+    unsigned long failures;
+    unsigned long rewound;      /* characters given back after partial matches */
+    struct profile_rule *next;
+    int registered;
+} profile_rule;
+
+/* The rules that have run so far, most recent first.  A combinator is
+ * listed once for each place it's used, under its own name. */
+const profile_rule *profile_rules(void);
+
+/* Print one line per rule, combining the entries for each combinator
+ * in a file: file, rule, calls, successes, failures and characters rewound. */
+void profile_dump(FILE *f);
+
+/* Zero every counter */
+void profile_reset(void);
+
+#endif /* URI_PATH_FINDER_PROFILE_H */
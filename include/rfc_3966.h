@@ -35,6 +35,8 @@
 
 #include <stddef.h>
 
+#include "charset.h"
+
 typedef struct Pars {
     char *ext;
     char *ext_stop;
@@ -42,6 +44,12 @@ typedef struct Pars {
     char *isdn_stop;
     char *context;
     char *context_stop;
+    char *npdi;          /* RFC 4694: present if the number was ported */
+    char *npdi_stop;
+    char *rn;            /* RFC 4694: routing number */
+    char *rn_stop;
+    char *cic;           /* RFC 4694: carrier identification code */
+    char *cic_stop;
     char *pars_1;
     char *pars_1_stop;
     char *pars_2;
@@ -50,6 +58,12 @@ typedef struct Pars {
     char *pars_3_stop;
     char *pars_4;
     char *pars_4_stop;
+    char *pars_5;
+    char *pars_5_stop;
+    char *pars_6;
+    char *pars_6_stop;
+    char *pars_7;
+    char *pars_7_stop;
 } Pars;
 
 typedef struct Tel {
@@ -59,29 +73,99 @@ typedef struct Tel {
     Pars pars;
 } Tel;
 
-/* For details about parse, get, and len API, see rfc_3986.h */
+/* For details about parse, get, and len API, see rfc_3986.h
+ *
+ * By default the parameters can come in any order.  Built with
+ * RFC_3966_CHECK_ORDER (make CHECK_ORDER=1), the order RFC 3966 gives
+ * is enforced: isdn-subaddress or extension first, then phone-context,
+ * then the rest sorted by name. */
 Tel parse_telephone(const char *s);
 
+/* As for parse_URI_charset */
+Tel parse_telephone_charset(const charset *cs, const char *s);
+
+/* Where and why a parse failed, as for URI_error.  The component is
+ * "scheme" if it doesn't start with "tel:", "number" if the number is
+ * invalid, "parameters" if a parameter is repeated or phone-context is
+ * missing from a local number or present in a global one, or "end" if
+ * the number and parameters are followed by anything else. */
+typedef struct Tel_error {
+    size_t offset;
+    const char *component;
+} Tel_error;
+
+Tel parse_telephone_error(const char *s, Tel_error *error);
+
+/* Callbacks for parse_telephone_events, either of which can be NULL.
+ * Each is given the ctx passed to parse_telephone_events and spans of
+ * the input, which aren't NULL terminated.
+ *
+ * number is called with the number, which is global if it starts with
+ * "+", and then parameter is called with each parameter in the order
+ * written, without its ";".  A parameter without "=" has a NULL value. */
+typedef struct Tel_handler {
+    void (*number)(void *ctx, const char *start, size_t len);
+    void (*parameter)(void *ctx, const char *name, size_t name_len, const char *value, size_t value_len);
+} Tel_handler;
+
+/* Parse a tel URI as parse_telephone does and report its parts to the
+ * handler.  The parameters are only valid as a set, so nothing is
+ * reported unless the whole tel URI is valid.
+ *
+ * Unlike parse_telephone this isn't counted by metrics.h. */
+Tel parse_telephone_events(const char *s, const Tel_handler *handler, void *ctx);
+
+/* Whether the len bytes at uri are a valid tel URI, as for is_valid_URI.
+ * The bytes are checked in place in a single pass, with each parameter's
+ * name looked up once to check it isn't repeated. */
+int is_valid_telephone(const char *uri, size_t len);
+
 char *get_global_number(const Tel *, char *, size_t *);
 char *get_local_number(const Tel *, char *, size_t *);
-char *get_pars(const Tel *, char *, size_t *); /* combo of pars_1/2/3/4 */
+char *get_pars(const Tel *, char *, size_t *); /* combo of pars_1..7 */
 char *get_par_ext(const Tel *, char *, size_t *);
 char *get_par_isdn(const Tel *, char *, size_t *);
 char *get_par_context(const Tel *, char *, size_t *);
+char *get_par_npdi(const Tel *, char *, size_t *);
+char *get_par_rn(const Tel *, char *, size_t *);
+char *get_par_cic(const Tel *, char *, size_t *);
 char *get_par_pars_1(const Tel *, char *, size_t *);
 char *get_par_pars_2(const Tel *, char *, size_t *);
 char *get_par_pars_3(const Tel *, char *, size_t *);
 char *get_par_pars_4(const Tel *, char *, size_t *);
+char *get_par_pars_5(const Tel *, char *, size_t *);
+char *get_par_pars_6(const Tel *, char *, size_t *);
+char *get_par_pars_7(const Tel *, char *, size_t *);
 
 size_t len_global_number(const Tel *);
 size_t len_local_number(const Tel *);
-size_t len_pars(const Tel *); /* combo of pars_1/2/3/4 */
+size_t len_pars(const Tel *); /* combo of pars_1..7 */
 size_t len_par_ext(const Tel *);
 size_t len_par_isdn(const Tel *);
 size_t len_par_context(const Tel *);
+size_t len_par_npdi(const Tel *);
+size_t len_par_rn(const Tel *);
+size_t len_par_cic(const Tel *);
 size_t len_par_pars_1(const Tel *);
 size_t len_par_pars_2(const Tel *);
 size_t len_par_pars_3(const Tel *);
 size_t len_par_pars_4(const Tel *);
+size_t len_par_pars_5(const Tel *);
+size_t len_par_pars_6(const Tel *);
+size_t len_par_pars_7(const Tel *);
+
+/* Compare two parsed tel URIs for equivalence per RFC 3966 section 4.
+ * Both must be global or both local, and their numbers must be the
+ * same once visual separators are removed.  Parameters are compared
+ * as an unordered set, and the phone-context is compared as a domain
+ * name or as digits without visual separators depending on its form.
+ * All comparisons are case-insensitive.  This works directly on the
+ * parsed Tels without allocating or copying.  A Tel that didn't parse
+ * isn't equal to anything. */
+int tel_equal(const Tel *, const Tel *);
+
+/* A hash consistent with tel_equal: Tels that are equal have equal
+ * hashes, regardless of parameter order, case, or visual separators. */
+size_t tel_hash(const Tel *);
 
 #endif /* URI_PATH_FINDER_RFC_3966_H */
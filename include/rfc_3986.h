@@ -35,8 +35,22 @@
 
 #include <stddef.h>
 
+#include "charset.h"
+
 /* A parser for the RFC 3986 URI Generic Syntax.
- * The grammar is taken from Appendix A of the RFC */
+ * The grammar is taken from Appendix A of the RFC
+ *
+ * Deployments that never accept some parts of the grammar can build
+ * without them, for less code and fewer alternatives on every parse.
+ * URIs that use a part that was left out are then invalid, in every
+ * function here:
+ *   URI_NO_IPVFUTURE       (make NO_IPVFUTURE=1)  "[v1.x]" hosts
+ *   URI_NO_IPV6            (make NO_IPV6=1)       "[::1]" hosts
+ *   URI_NO_USERINFO        (make NO_USERINFO=1)   "user@" before the host
+ *   URI_NO_CUSTOM_CHARSET  (make NO_CUSTOM_CHARSET=1)
+ *                          the grammars aren't built for custom charsets,
+ *                          and parse_*_charset reject every input with one
+ * make MINIMAL=1 leaves out all four. */
 
 typedef struct URI {
     char *scheme;
@@ -68,6 +82,105 @@ typedef struct URI {
  *       thus linked to the lifetime of the original string. */
 URI parse_URI(const char *);
 
+/* The same as parse_URI, but accepting the letters and digits of the
+ * given charset, see charset.h.  NULL is ASCII. */
+URI parse_URI_charset(const charset *, const char *);
+
+/* IRIs (RFC 3987): the same as parse_URI, but also accepting the
+ * non-ASCII characters RFC 3987 allows, in UTF-8, where it allows
+ * them: ucschar in the userinfo, host, path, query and fragment, and
+ * iprivate in the query only.  The scheme, port and IP literals are
+ * still ASCII.  Invalid UTF-8 anywhere in the IRI makes it invalid. */
+URI parse_IRI(const char *);
+
+/* Converts an IRI to a URI by pct-encoding every byte from 0x80, in a
+ * single pass.  The IRI isn't checked, so parse it first.  The buffer
+ * is as for the getters below, except that if it's too small, it may
+ * have been partly written. */
+char *IRI_to_URI(const char *iri, char *, size_t *);
+
+/* Where and why a parse failed.  The offset is of the first character
+ * that couldn't be parsed, and the component is the part of the URI it
+ * was in: "scheme", "colon" (the scheme isn't followed by ':'),
+ * "authority", "path", "query", or "fragment". */
+typedef struct URI_error {
+    size_t offset;
+    const char *component;
+} URI_error;
+
+/* The same as parse_URI, but if the URI is invalid it also fills in
+ * the error, which is otherwise left unchanged.  It costs no more than
+ * parse_URI when the URI is valid. */
+URI parse_URI_error(const char *, URI_error *);
+
+/* The components of a URI, in order, for parse_URI_until. */
+typedef enum URI_component {
+    URI_SCHEME,
+    URI_AUTHORITY,
+    URI_PATH,
+    URI_QUERY,
+    URI_FRAGMENT
+} URI_component;
+
+/* Parse a URI only up to and including the last component given,
+ * leaving the fields of the rest NULL.  The end field is set to where
+ * parsing stopped, so the len_* and get_* functions work on the fields
+ * that were parsed.  The URI is checked as far as it was parsed and
+ * the character after it must be able to start the next component,
+ * otherwise all fields are NULL.  Parsing up to URI_FRAGMENT is the
+ * same as parse_URI.
+ *
+ * A partial result can be passed to parse_URI_resume to parse more of
+ * it, up to another component, without reparsing what it already has.
+ *
+ * Unlike parse_URI these aren't counted by metrics.h. */
+URI parse_URI_until(const char *, URI_component last);
+URI parse_URI_resume(const URI *partial, URI_component last);
+
+/* The fields of a URI, as in the get_* and len_* functions. */
+typedef enum URI_field {
+    URI_FIELD_SCHEME,
+    URI_FIELD_USERINFO,
+    URI_FIELD_HOST,
+    URI_FIELD_PORT,
+    URI_FIELD_PATH,
+    URI_FIELD_QUERY,
+    URI_FIELD_FRAGMENT,
+    URI_FIELDS
+} URI_field;
+
+/* Callbacks for parse_URI_events, any of which can be NULL.  Each is
+ * given the ctx passed to parse_URI_events and a span of the input,
+ * which isn't NULL terminated.
+ *
+ * field is called with each field present, in order.  After the path,
+ * segment is called with each of its "/" separated segments, and after
+ * the query, query_pair is called with each of its non-empty "&"
+ * separated pairs, split at the first "=".  A pair without "=" has a
+ * NULL value. */
+typedef struct URI_handler {
+    void (*field)(void *ctx, URI_field field, const char *start, size_t len);
+    void (*segment)(void *ctx, const char *start, size_t len);
+    void (*query_pair)(void *ctx, const char *key, size_t key_len, const char *value, size_t value_len);
+} URI_handler;
+
+/* Parse a URI as parse_URI does, calling the handler as each component
+ * is parsed, so the caller can build its own representation of it in
+ * the same pass.  The URI is only known to be valid once this returns,
+ * and if it isn't, some components may already have been reported
+ * before the result comes back with all fields NULL.
+ *
+ * Unlike parse_URI this isn't counted by metrics.h. */
+URI parse_URI_events(const char *, const URI_handler *handler, void *ctx);
+
+/* Whether the len bytes at uri are a valid URI, without building the
+ * URI struct.  It accepts exactly what parse_URI accepts by default, but
+ * the input doesn't need to be NULL terminated, and a NULL byte in it is
+ * invalid.  Bytes the grammar never uses are found in a single pass
+ * before anything else is checked, and it returns as soon as one is.
+ * It only handles ASCII. */
+int is_valid_URI(const char *uri, size_t len);
+
 /* Accordingly, it's preferable to retrieve the fields of the
  * URI via these getters that create a NULL-terminated copy in
  * a user-supplied buffer.  This takes O(n) time, though.
@@ -98,4 +211,69 @@ size_t len_path(const URI *);
 size_t len_query(const URI *);
 size_t len_fragment(const URI *);
 
+/* A field as a span of the original string, which isn't NULL
+ * terminated.  ptr is NULL and len is 0 if the field is missing. */
+typedef struct URI_view {
+    const char *ptr;
+    size_t len;
+} URI_view;
+
+/* Every field, indexed by URI_field */
+typedef struct URI_views {
+    URI_view field[URI_FIELDS];
+} URI_views;
+
+/* All the fields at once.  Each field ends at the delimiter the parse
+ * recorded for the next field present, so rather than each len_* looking
+ * for it separately, one walk back from the end finds every length. */
+URI_views get_URI_views(const URI *);
+
+/* Copies several fields into one buffer with one call, for callers that
+ * would otherwise call a getter for each.  fields is a mask of the fields
+ * wanted, (1 << URI_FIELD_HOST) | (1 << URI_FIELD_PATH) for example, or
+ * URI_ALL_FIELDS.  Each field wanted and present is NULL terminated in
+ * buf, and offsets[field] is set to where it starts.  The offsets of the
+ * rest are set to URI_FIELD_ABSENT.
+ *
+ * To copy with as few calls to memcpy as possible, the fields keep their
+ * places relative to each other, from the first field wanted to the end
+ * of the last, with a NULL terminating byte in place of the delimiter
+ * after each one.  The path, which has no delimiter before it, goes last.
+ * So the buffer needs at most the length of the URI plus that of the
+ * path, and two bytes.
+ *
+ * If the buffer is too small, the function returns NULL, the buffer and
+ * offsets are not changed, and the length field is set to the size the
+ * buffer needs, with the NULL terminating bytes.  Otherwise it returns
+ * buf and the length field is unchanged. */
+#define URI_ALL_FIELDS ((1u << URI_FIELDS) - 1)
+#define URI_FIELD_ABSENT ((size_t)-1)
+char *get_URI_fields(const URI *, unsigned int fields, char *, size_t *, size_t offsets[URI_FIELDS]);
+
+/* Builds a URI out of its fields, writing them into the buffer with the
+ * delimiters between them, and returns the URI struct for it as parse_URI
+ * would have, without parsing it.  A NULL ptr leaves the field out, and a
+ * NULL path is empty.  The fields have to be pct-encoded already, and
+ * each has to be valid on its own and where it ends up: a scheme is
+ * required, the userinfo and port need a host, and with a host the path
+ * has to be empty or start with "/", while without one it can't start
+ * with "//".
+ *
+ * The buffer is as for the getters: if it's too small the length field
+ * is set to the length of the URI, excluding the NULL terminating byte.
+ * If the fields don't make a valid URI, the length field is set to 0.
+ * Either way all fields of the returned URI are NULL. */
+URI build_URI(const URI_views *, char *, size_t *);
+
+/* Rewrites one field of a parsed URI, as build_URI would with the other
+ * fields as they are.  Only the new value is checked, so the URI can also
+ * come from parse_IRI or parse_URI_charset.  A NULL value removes the
+ * field, so to remove the authority the userinfo and port have to go
+ * before the host.  The buffer can't overlap the string the URI is in. */
+URI edit_URI(const URI *, URI_field field, const char *value, size_t value_len, char *, size_t *);
+
+/* Adds a pair such as "key=value", which has to be pct-encoded, to the
+ * end of the query, after an "&" unless the query is empty or missing. */
+URI append_URI_query(const URI *, const char *pair, size_t pair_len, char *, size_t *);
+
 #endif /* URI_PATH_FINDER_RFC_3986_H */
@@ -0,0 +1,66 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef URI_PATH_FINDER_SIMD_H
+#define URI_PATH_FINDER_SIMD_H
+
+/* The scans that find the next character of a class, such as the
+ * characters neither grammar uses, the bytes from 0x80 that IRI_to_URI
+ * pct-encodes, or the "%" that starts a pct-encoded host byte, have a
+ * version for each of these instruction sets.  The best one the CPU
+ * supports is picked once when the library is loaded.
+ *
+ * Building with URI_SIMD_FORCE (make SIMD=scalar, sse2, avx2 or avx512)
+ * picks that level instead, if the CPU supports it, so the benchmarks
+ * can compare the levels on one machine. */
+typedef enum simd_level {
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_AVX512,
+    SIMD_LEVELS
+} simd_level;
+
+/* The level in use */
+simd_level simd_get_level(void);
+
+/* Whether the library was built with the level and the CPU supports it */
+int simd_supported(simd_level level);
+
+/* Switch to another level, returning 0 and keeping the current one if
+ * it isn't supported.  Only safe while no other thread is parsing. */
+int simd_set_level(simd_level level);
+
+/* "scalar", "sse2", "avx2" or "avx512" */
+const char *simd_level_name(simd_level level);
+
+#endif /* URI_PATH_FINDER_SIMD_H */
@@ -0,0 +1,87 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef URI_PATH_FINDER_TEL_PREFIX_H
+#define URI_PATH_FINDER_TEL_PREFIX_H
+
+#include <stddef.h>
+
+#include "rfc_3966.h"
+
+/* A longest-prefix-match table over the digits of telephone numbers,
+ * e.g., for routing on country code, carrier block, or number range.
+ *
+ * Each node is a 16-way branch on a single HEXDIG, laid out flat as
+ * a DFA over caller-supplied storage, so a node is exactly one cache
+ * line and a lookup touches one node per digit.  Whether the prefix
+ * ending at a node has a value is kept in the edge leading to it, so
+ * the value array is only read once, at the end of the lookup.
+ *
+ * The table is built once with tel_prefix_insert and afterwards is
+ * only read, so it can be shared between threads without locking. */
+
+typedef struct tel_prefix_node {
+    unsigned int child[16];
+} tel_prefix_node;
+
+typedef struct tel_prefix_table {
+    size_t size;
+    size_t entries;
+    tel_prefix_node *nodes;
+    unsigned int *values;
+} tel_prefix_table;
+
+/* Prepare an empty table over the caller's storage.  Both nodes and
+ * values must hold size entries.  A table of n prefixes needs at most
+ * one node per prefix digit, plus one for the root. */
+void tel_prefix_init(tel_prefix_table *, tel_prefix_node *, unsigned int *, size_t);
+
+/* Add a prefix, given as global-number-digits or phonedigit-hex with
+ * an optional leading "+" and any visual separators, which are skipped.
+ * The value must not be 0, which is reserved for no match.  Returns 0
+ * if the prefix is empty, has other characters, is already present,
+ * or the table is out of nodes, and 1 otherwise. */
+int tel_prefix_insert(tel_prefix_table *, const char *, size_t, unsigned int);
+
+/* Look up the longest prefix of the global_number of a parsed Tel.
+ * Visual separators are skipped on the fly.  Returns the value of the
+ * longest prefix present, or 0 if there is none or the Tel has no
+ * global number. */
+unsigned int tel_prefix_lookup(const tel_prefix_table *, const Tel *);
+
+/* Look up n Tels at once, writing each result into the values array.
+ * The lookups are interleaved so that their memory accesses overlap,
+ * which is considerably faster than n calls on a table that doesn't
+ * fit in cache. */
+void tel_prefix_lookup_n(const tel_prefix_table *, const Tel *, size_t, unsigned int *);
+
+#endif /* URI_PATH_FINDER_TEL_PREFIX_H */
@@ -0,0 +1,67 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef URI_PATH_FINDER_TEL_SCAN_H
+#define URI_PATH_FINDER_TEL_SCAN_H
+
+#include <stddef.h>
+
+#include "rfc_3966.h"
+
+/* Extraction of telephone numbers written in free form text, such as
+ * "call +1 (415) 555-2671", into tel URIs.
+ *
+ * Candidates are runs of digits, "+", visual separators and spaces that
+ * aren't part of a longer word.  The runs are located with a vectorized
+ * scan, so text without digits costs little more than reading it.  Each
+ * candidate is turned into a tel URI, with spaces written as "-", and
+ * kept only if parse_telephone accepts it. */
+
+typedef struct tel_match {
+    const char *start;  /* the number as it appears in the text */
+    const char *stop;
+    char *uri;          /* NULL terminated tel URI in the caller's buffer */
+    Tel tel;            /* the parse of uri */
+} tel_match;
+
+/* Scan len bytes of text for telephone numbers.
+ * Numbers starting with "+" become global numbers.  Others become local
+ * numbers with the given phone-context, or are skipped if it is NULL.
+ * Candidates with fewer than min_digits digits are skipped.
+ * Matches are stored in order, with their URIs written one after the
+ * other into buf.  Returns the number of matches stored, which stops
+ * short of the text when either the matches or the buffer run out; in
+ * that case scanning can resume from the stop of the last match. */
+size_t scan_telephone(const char *text, size_t len, const char *context, unsigned int min_digits,
+                      tel_match *matches, size_t n, char *buf, size_t buf_len);
+
+#endif /* URI_PATH_FINDER_TEL_SCAN_H */
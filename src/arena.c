@@ -0,0 +1,140 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct URI_arena_chunk {
+    URI_arena_chunk *next;
+    size_t size;
+    char data[];
+};
+
+static __thread URI_arena thread_arena;
+static __thread int thread_arena_ready = 0;
+
+void URI_arena_init(URI_arena *a, size_t chunk_size) {
+    a->chunk_size = chunk_size ? chunk_size : URI_ARENA_CHUNK_SIZE;
+    a->chunks = NULL;
+    a->current = NULL;
+    a->next = NULL;
+    a->end = NULL;
+    a->used = 0;
+}
+
+/* Moves on to the first chunk after the current one with room for
+ * size bytes, allocating one at the end if none has. */
+static int arena_grow(URI_arena *a, size_t size) {
+    URI_arena_chunk *chunk = a->current ? a->current->next : a->chunks;
+    URI_arena_chunk **last = a->current ? &a->current->next : &a->chunks;
+    for (; chunk != NULL && chunk->size < size; last = &chunk->next, chunk = chunk->next);
+    if (chunk == NULL) {
+        size_t chunk_size = size > a->chunk_size ? size : a->chunk_size;
+        chunk = malloc(sizeof(URI_arena_chunk) + chunk_size);
+        if (chunk == NULL) {
+            return 0;
+        }
+        chunk->next = NULL;
+        chunk->size = chunk_size;
+        *last = chunk;
+    }
+    /* Chunks skipped over for being too small stay unused until the
+       next reset, which only happens after an oversized URI */
+    a->current = chunk;
+    a->next = chunk->data;
+    a->end = chunk->data + chunk->size;
+    return 1;
+}
+
+char *URI_arena_copy(URI_arena *a, const char *s, size_t len) {
+    char *copy = NULL;
+    if ((size_t)(a->end - a->next) <= len && !arena_grow(a, len + 1)) {
+        return NULL;
+    }
+    copy = a->next;
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    a->next += len + 1;
+    a->used += len + 1;
+    return copy;
+}
+
+URI parse_URI_into_arena(URI_arena *a, const char *s) {
+    URI uri = parse_URI(s);
+    char *copy = NULL;
+    if (uri.scheme == NULL) {
+        return uri;
+    }
+    copy = URI_arena_copy(a, s, uri.end - s);
+    if (copy == NULL) {
+        memset(&uri, 0, sizeof(uri));
+        return uri;
+    }
+#define REBASE(member) uri.member = uri.member ? copy + (uri.member - s) : NULL
+    REBASE(scheme); REBASE(colon_s); REBASE(slash); REBASE(userinfo); REBASE(atsymbol);
+    REBASE(host); REBASE(colon_p); REBASE(port); REBASE(path); REBASE(question);
+    REBASE(query); REBASE(pound); REBASE(fragment); REBASE(end);
+#undef REBASE
+    return uri;
+}
+
+size_t URI_arena_used(const URI_arena *a) {
+    return a->used;
+}
+
+void URI_arena_reset(URI_arena *a) {
+    a->current = NULL;
+    a->next = NULL;
+    a->end = NULL;
+    a->used = 0;
+}
+
+void URI_arena_free(URI_arena *a) {
+    URI_arena_chunk *chunk = a->chunks;
+    while (chunk != NULL) {
+        URI_arena_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    URI_arena_init(a, a->chunk_size);
+}
+
+URI_arena *URI_thread_arena(void) {
+    if (!thread_arena_ready) {
+        URI_arena_init(&thread_arena, 0);
+        thread_arena_ready = 1;
+    }
+    return &thread_arena;
+}
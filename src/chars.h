@@ -35,6 +35,8 @@
 
 #include <stddef.h>
 
+#include "simd_kernels.h"
+
 /* Match a single character */
 static const char *parse_char(const char **s, char c) {
     const char *match = NULL;
@@ -85,26 +87,22 @@ MAKE_PARSE(comma,      ',')
 MAKE_PARSE(semicolon,  ';')
 MAKE_PARSE(equal,      '=')
 
-/* By default RFC-3986 etc. only handle ASCII.  If more characters
- * are needed, set the functions to handle them.  They must
- * return a pointer to the character if found and advance the
- * argument to beyond the character. If not found, return NULL
- * and do not advance the argument. */
-static parser alpha_parser = NULL;
-static parser digit_parser = NULL;
-
-void set_alpha_parser(parser p) {
-    alpha_parser = p;
-}
+/* RFC-3986 etc. only handle ASCII, but each grammar is also compiled
+ * with URI_CHARSET set to accept the other character sets in charset.h:
+ * UTF-8, or a custom charset set for the current thread.  RFC 3986 is
+ * compiled once more for the IRIs of RFC 3987, which keep ASCII letters
+ * and digits but add ucschar and iprivate to some rules.  Without it,
+ * the ASCII rules below are all there is. */
+#define URI_CHARSET_ASCII  0
+#define URI_CHARSET_UTF8   1
+#define URI_CHARSET_CUSTOM 2
+#define URI_CHARSET_IRI    3
 
-void set_digit_parser(parser p) {
-    digit_parser = p;
-}
+#ifndef URI_CHARSET
+#define URI_CHARSET URI_CHARSET_ASCII
+#endif
 
-static const char *parse_alpha(const char **s) {
-    if (alpha_parser != NULL) {
-        return alpha_parser(s);
-    }
+static const char *parse_ascii_alpha(const char **s) {
     const char *match = NULL;
     char c = **s;
     if (((c >= 'A') && (c <= 'Z')) ||
@@ -115,10 +113,7 @@ static const char *parse_alpha(const char **s) {
     return match;
 }
 
-static const char *parse_digit(const char **s) {
-    if (digit_parser != NULL) {
-        return digit_parser(s);
-    }
+static const char *parse_ascii_digit(const char **s) {
     const char *match = NULL;
     char c = **s;
     if ((c >= '0') && (c <= '9')) {
@@ -128,6 +123,135 @@ static const char *parse_digit(const char **s) {
     return match;
 }
 
+/* A well-formed multi-byte UTF-8 sequence: no overlong forms, no
+ * surrogates, and nothing past U+10FFFF */
+static const char *parse_utf8_sequence(const char **s) {
+    const unsigned char *p = (const unsigned char *)*s;
+    const char *match = NULL;
+    size_t n = 0;
+    size_t i = 0;
+    if (p[0] >= 0xC2 && p[0] <= 0xDF) {
+        n = 2;
+    } else if (p[0] >= 0xE0 && p[0] <= 0xEF &&
+               !(p[0] == 0xE0 && p[1] < 0xA0) &&
+               !(p[0] == 0xED && p[1] > 0x9F)) {
+        n = 3;
+    } else if (p[0] >= 0xF0 && p[0] <= 0xF4 &&
+               !(p[0] == 0xF0 && p[1] < 0x90) &&
+               !(p[0] == 0xF4 && p[1] > 0x8F)) {
+        n = 4;
+    }
+    for (i = 1; i < n && (p[i] & 0xC0) == 0x80; i++);
+    if (n != 0 && i == n) {
+        match = *s;
+        *s = (*s) + n;
+    }
+    return match;
+}
+
+#if URI_CHARSET == URI_CHARSET_CUSTOM
+#include "charset.h"
+
+extern __thread const charset *charset_current;
+
+static const char *parse_alpha(const char **s) {
+    const charset *cs = charset_current;
+    return cs->alpha != NULL ? cs->alpha(s) : parse_ascii_alpha(s);
+}
+
+static const char *parse_digit(const char **s) {
+    const charset *cs = charset_current;
+    return cs->digit != NULL ? cs->digit(s) : parse_ascii_digit(s);
+}
+#elif URI_CHARSET == URI_CHARSET_UTF8
+static const char *parse_alpha(const char **s) {
+    const char *match = parse_ascii_alpha(s);
+    return match != NULL ? match : parse_utf8_sequence(s);
+}
+
+static const char *parse_digit(const char **s) {
+    return parse_ascii_digit(s);
+}
+#else
+static const char *parse_alpha(const char **s) {
+    return parse_ascii_alpha(s);
+}
+
+static const char *parse_digit(const char **s) {
+    return parse_ascii_digit(s);
+}
+#endif /* URI_CHARSET */
+
+#if URI_CHARSET == URI_CHARSET_IRI
+/* The IRI grammar is only run on input that find_invalid_utf8 has
+ * passed, so a lead byte is always followed by its continuation bytes,
+ * and this doesn't need to check them again. */
+static unsigned long utf8_code_point(const char *p, size_t *n) {
+    const unsigned char *u = (const unsigned char *)p;
+    if (u[0] < 0xE0) {
+        *n = 2;
+        return (u[0] & 0x1FUL) << 6 | (u[1] & 0x3F);
+    } else if (u[0] < 0xF0) {
+        *n = 3;
+        return (u[0] & 0x0FUL) << 12 | (u[1] & 0x3FUL) << 6 | (u[2] & 0x3F);
+    }
+    *n = 4;
+    return (u[0] & 0x07UL) << 18 | (u[1] & 0x3FUL) << 12 | (u[2] & 0x3FUL) << 6 | (u[3] & 0x3F);
+}
+
+/* ucschar = %xA0-D7FF / %xF900-FDCF / %xFDF0-FFEF
+ *         / %x10000-1FFFD / %x20000-2FFFD / %x30000-3FFFD
+ *         / %x40000-4FFFD / %x50000-5FFFD / %x60000-6FFFD
+ *         / %x70000-7FFFD / %x80000-8FFFD / %x90000-9FFFD
+ *         / %xA0000-AFFFD / %xB0000-BFFFD / %xC0000-CFFFD
+ *         / %xD0000-DFFFD / %xE1000-EFFFD */
+static const char *parse_ucschar(const char **s) {
+    const char *match = NULL;
+    if ((unsigned char)**s >= 0x80) {
+        size_t n = 0;
+        unsigned long c = utf8_code_point(*s, &n);
+        unsigned long plane = c >> 16;
+        unsigned long low = c & 0xFFFF;
+        if (plane == 0 ? (c >= 0xA0 && c <= 0xD7FF) ||
+                         (c >= 0xF900 && c <= 0xFDCF) ||
+                         (c >= 0xFDF0 && c <= 0xFFEF) :
+            plane <= 13 ? low <= 0xFFFD :
+            plane == 14 && low >= 0x1000 && low <= 0xFFFD) {
+            match = *s;
+            *s = (*s) + n;
+        }
+    }
+    return match;
+}
+
+/* iprivate = %xE000-F8FF / %xF0000-FFFFD / %x100000-10FFFD */
+static const char *parse_iprivate(const char **s) {
+    const char *match = NULL;
+    if ((unsigned char)**s >= 0x80) {
+        size_t n = 0;
+        unsigned long c = utf8_code_point(*s, &n);
+        if ((c >= 0xE000 && c <= 0xF8FF) ||
+            (c >= 0xF0000 && (c & 0xFFFF) <= 0xFFFD)) {
+            match = *s;
+            *s = (*s) + n;
+        }
+    }
+    return match;
+}
+#endif /* URI_CHARSET_IRI */
+
+/* The name of a grammar's entry point in this build, for dispatching on
+ * the charset from the ASCII build, which has the rest of the API */
+#if URI_CHARSET == URI_CHARSET_CUSTOM
+#define CHARSET_ENTRY(name) name##_custom
+#elif URI_CHARSET == URI_CHARSET_UTF8
+#define CHARSET_ENTRY(name) name##_utf8
+#elif URI_CHARSET == URI_CHARSET_IRI
+#define CHARSET_ENTRY(name) name##_iri
+#else
+#define CHARSET_ENTRY(name) name
+#endif
+
 static const char *parse_hexdig(const char **s) {
     const char *match = NULL;
     char c = **s;
@@ -140,4 +264,49 @@ static const char *parse_hexdig(const char **s) {
     return match;
 }
 
+static int is_hexdig(char c) {
+    return ((c >= '0') && (c <= '9')) ||
+           ((c >= 'A') && (c <= 'F')) ||
+           ((c >= 'a') && (c <= 'f'));
+}
+
+/* Every character either grammar uses is printable ASCII, and only
+ * space and " < > \ ^ ` { | } are printable but unused. */
+static int is_uri_char(char c) {
+    return c > ' ' && c < 0x7f &&
+           c != '"' && c != '<' && c != '>' && c != '\\' && c != '^' &&
+           c != '`' && c != '{' && c != '|' && c != '}';
+}
+
+/* The scans run a vector at a time with the kernels of the level the
+ * CPU supports, see simd.c */
+
+/* Find the first character neither grammar uses */
+static const char *find_non_uri_char(const char *p, const char *end) {
+    return simd_active.find_non_uri_char(p, end);
+}
+
+/* Find the next "%", "#", "[" or "]" */
+static const char *find_tail_special(const char *p, const char *end) {
+    return simd_active.find_tail_special(p, end);
+}
+
+/* The first byte from 0x80 in [p, end), or end */
+static const char *find_non_ascii(const char *p, const char *end) {
+    return simd_active.find_non_ascii(p, end);
+}
+
+/* The first byte from p that doesn't start or continue a well-formed
+ * UTF-8 sequence, or end, which must be the string's NUL.  Runs of
+ * ASCII, the common case even in IRIs, are skipped a vector at a time,
+ * and only the bytes from 0x80 are decoded. */
+static const char *find_invalid_utf8(const char *p, const char *end) {
+    while ((p = find_non_ascii(p, end)) < end) {
+        if (parse_utf8_sequence(&p) == NULL) {
+            return p;
+        }
+    }
+    return p;
+}
+
 #endif /* URI_PATH_FINDER_CHARS_H */
@@ -33,7 +33,6 @@
 #ifndef URI_PATH_FINDER_HOF_H
 #define URI_PATH_FINDER_HOF_H
 
-#include <stdarg.h>
 #include <stddef.h>
 
 #define MAKE_LEN(ty, field, end) \
@@ -50,82 +49,180 @@
             *len = f_len; \
             return NULL; \
         } \
-        strncpy(buf, data->field, f_len); \
+        memcpy(buf, data->field, f_len); \
         buf[f_len] = '\0'; \
         return buf; \
     }
 
 typedef const char *(*parser)(const char **);
 
+/* Rule profiling, see profile.h.  Each rule starts with PROFILE_RULE(),
+ * returns through PROFILE_EXIT, and rewinds with PROFILE_REWIND, all of
+ * which compile to the plain code unless URI_PROFILE is defined. */
+#ifdef URI_PROFILE
+#include "profile.h"
+
+void profile_register(profile_rule *rule);
+
+static void profile_count(profile_rule *rule, int success) {
+    if (!rule->registered) {
+        profile_register(rule);
+    }
+    __atomic_fetch_add(success ? &rule->successes : &rule->failures, 1, __ATOMIC_RELAXED);
+}
+
+static void profile_rewind(profile_rule *rule, const char *from, const char *to) {
+    if (to != NULL && to < from) {
+        __atomic_fetch_add(&rule->rewound, from - to, __ATOMIC_RELAXED);
+    }
+}
+
+#define PROFILE_RULE_NAMED(name) \
+    static profile_rule profile_rule_ = { name, __FILE__, 0, 0, 0, NULL, 0 }
+#define PROFILE_RULE() \
+    PROFILE_RULE_NAMED(__func__)
+#define PROFILE_COUNT(success) \
+    profile_count(&profile_rule_, (success))
+#define PROFILE_EXIT(match) ({ \
+        const char *profile_match_ = (match); \
+        PROFILE_COUNT(profile_match_ != NULL); \
+        profile_match_; })
+#define PROFILE_REWIND(s, to) ({ \
+        const char *profile_to_ = (to); \
+        profile_rewind(&profile_rule_, *(s), profile_to_); \
+        *(s) = profile_to_; })
+#else
+#define PROFILE_RULE_NAMED(name)
+#define PROFILE_RULE()
+#define PROFILE_COUNT(success)
+#define PROFILE_EXIT(match) (match)
+#define PROFILE_REWIND(s, to) (*(s) = (to))
+#endif /* URI_PROFILE */
+
 /* Match the parser p exactly n times. */
 static const char *parse_n(const char **s, unsigned int n, parser p) {
+    PROFILE_RULE();
     const char *match = *s;
     unsigned int i = 0;
     for (i = 0; i < n; i++) {
         const char *v = p(s);
         if (v == NULL) {
-            *s = match;
-            return NULL;
+            PROFILE_REWIND(s, match);
+            return PROFILE_EXIT(NULL);
         }
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* Match the parser p at least n times. */
 static const char *parse_n_star(const char **s, unsigned int n, parser p) {
+    PROFILE_RULE();
     const char *match = parse_n(s, n, p);
     while (p(s) != NULL);
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* Match the parser p at least n times. */
 static const char *parse_n_to_m(const char **s, unsigned int n, unsigned int m, parser p) {
+    PROFILE_RULE();
     const char *match = parse_n(s, n, p);
     unsigned int i = n;
     for (i = n; i < m && p(s) != NULL; i++);
-    return match;
+    return PROFILE_EXIT(match);
 }
 
-/* Match the first of n parsers that matches */
-static const char *parse_opt(const char **s, unsigned int n, ...) {
-    const char *match = NULL;
-    va_list ap;
-    va_start(ap, n);
-    while (n-- > 0) {
-        const char *tmp = *s;
-        parser p = va_arg(ap, parser);
-        match = p(&tmp);
-        if (match != NULL) {
-            *s = tmp;
-            break;
-        }
-    }
-    va_end(ap);
-    return match;
-}
+/* The combinators below are macros rather than functions, so that each
+ * parser they're given is called directly where the rule is written,
+ * and can be inlined there, instead of through a va_list of function
+ * pointers.  COUNT_ARGS and FOR_EACH_ARG expand a macro once for each
+ * of up to 12 parsers. */
+#define COUNT_ARGS(...) COUNT_ARGS_(__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define COUNT_ARGS_(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, n, ...) n
+#define FOR_EACH_ARG(m, ...) FOR_EACH_ARG_(COUNT_ARGS(__VA_ARGS__), m, __VA_ARGS__)
+#define FOR_EACH_ARG_(n, m, ...) FOR_EACH_ARG__(n, m, __VA_ARGS__)
+#define FOR_EACH_ARG__(n, m, ...) FOR_EACH_ARG_##n(m, __VA_ARGS__)
+#define FOR_EACH_ARG_1(m, a)       m(a)
+#define FOR_EACH_ARG_2(m, a, ...)  m(a) FOR_EACH_ARG_1(m, __VA_ARGS__)
+#define FOR_EACH_ARG_3(m, a, ...)  m(a) FOR_EACH_ARG_2(m, __VA_ARGS__)
+#define FOR_EACH_ARG_4(m, a, ...)  m(a) FOR_EACH_ARG_3(m, __VA_ARGS__)
+#define FOR_EACH_ARG_5(m, a, ...)  m(a) FOR_EACH_ARG_4(m, __VA_ARGS__)
+#define FOR_EACH_ARG_6(m, a, ...)  m(a) FOR_EACH_ARG_5(m, __VA_ARGS__)
+#define FOR_EACH_ARG_7(m, a, ...)  m(a) FOR_EACH_ARG_6(m, __VA_ARGS__)
+#define FOR_EACH_ARG_8(m, a, ...)  m(a) FOR_EACH_ARG_7(m, __VA_ARGS__)
+#define FOR_EACH_ARG_9(m, a, ...)  m(a) FOR_EACH_ARG_8(m, __VA_ARGS__)
+#define FOR_EACH_ARG_10(m, a, ...) m(a) FOR_EACH_ARG_9(m, __VA_ARGS__)
+#define FOR_EACH_ARG_11(m, a, ...) m(a) FOR_EACH_ARG_10(m, __VA_ARGS__)
+#define FOR_EACH_ARG_12(m, a, ...) m(a) FOR_EACH_ARG_11(m, __VA_ARGS__)
 
-/* Match all parsers in order */
-static const char *parse_cat(const char **s, unsigned int n, ...) {
-    const char *match = NULL;
-    va_list ap;
-    va_start(ap, n);
-    if (n-- > 0) {
-        parser p = va_arg(ap, parser);
-        match = p(s);
-    }
-    if (match != NULL) {
-        while (n-- > 0) {
-            parser p = va_arg(ap, parser);
-            if (p(s) == NULL) {
-                /* failed, rewind */
-                *s = match;
-                match = NULL;
-                break;
-            }
-        }
-    }
-    va_end(ap);
-    return match;
-}
+/* Each use of a combinator is profiled as a rule of its own name, so
+ * that they're counted over every file that uses them, as profile.h
+ * describes. */
+
+/* Match the first of the parsers that matches.  Each is tried on a copy
+ * of the input, which is only advanced by the one that matches. */
+#define PARSE_OPT(s, ...) ({ \
+        PROFILE_RULE_NAMED("parse_opt"); \
+        const char **opt_s_ = (s); \
+        const char *opt_tmp_ = *opt_s_; \
+        const char *opt_match_ = NULL; \
+        if (FOR_EACH_ARG(PARSE_OPT_TRY_, __VA_ARGS__) 0) { \
+            *opt_s_ = opt_tmp_; \
+        } \
+        PROFILE_EXIT(opt_match_); })
+#define PARSE_OPT_TRY_(p) \
+    (opt_tmp_ = *opt_s_, (opt_match_ = p(&opt_tmp_)) != NULL) ||
+
+/* Match the first of the parsers that matches, where no two of them can
+ * match starting with the same character.  Only one of them can match
+ * at any point, so their order doesn't matter, and the one that can is
+ * decided by the next character.
+ *
+ * With URI_ADAPTIVE defined (make ADAPTIVE=1), each call site keeps a
+ * per-thread table of which parser matched after each ASCII character,
+ * filled in as the input is seen.  Once a character is in the table,
+ * only its parser is tried, and if that fails none of the others could
+ * match either.  Characters from 0x80 aren't cached, since the letters of
+ * a UTF-8 or custom charset may share leading bytes.  Failures are never
+ * cached, as a parser can fail on one input and match another starting
+ * with the same character, like "%zz" and "%20".  Nothing is cached in
+ * the URI_CHARSET_CUSTOM build, where a thread can switch between custom
+ * charsets whose letters and digits differ even in ASCII. */
+#ifdef URI_ADAPTIVE
+#define PARSE_OPT_DISJOINT(s, ...) ({ \
+        PROFILE_RULE_NAMED("parse_opt_cached"); \
+        static __thread unsigned char opt_cache_[0x80]; \
+        const char **opt_s_ = (s); \
+        const char *opt_tmp_ = *opt_s_; \
+        const char *opt_match_ = NULL; \
+        const unsigned char opt_c_ = (unsigned char)*opt_tmp_; \
+        const bool opt_cacheable_ = URI_CHARSET != URI_CHARSET_CUSTOM && opt_c_ < 0x80; \
+        const unsigned int opt_known_ = opt_cacheable_ ? opt_cache_[opt_c_] : 0; \
+        unsigned int opt_i_ = 0; \
+        if (FOR_EACH_ARG(PARSE_OPT_CACHED_TRY_, __VA_ARGS__) 0) { \
+            *opt_s_ = opt_tmp_; \
+            if (opt_known_ == 0 && opt_cacheable_) { \
+                opt_cache_[opt_c_] = opt_i_; \
+            } \
+        } \
+        PROFILE_EXIT(opt_match_); })
+#define PARSE_OPT_CACHED_TRY_(p) \
+    (++opt_i_, (opt_known_ == 0 || opt_known_ == opt_i_) && \
+               (opt_tmp_ = *opt_s_, (opt_match_ = p(&opt_tmp_)) != NULL)) ||
+#else
+#define PARSE_OPT_DISJOINT PARSE_OPT
+#endif /* URI_ADAPTIVE */
+
+/* Match all parsers in order, rewinding to the start if any fails */
+#define PARSE_CAT(s, first, ...) ({ \
+        PROFILE_RULE_NAMED("parse_cat"); \
+        const char **cat_s_ = (s); \
+        const char *cat_match_ = first(cat_s_); \
+        if (cat_match_ != NULL && !(FOR_EACH_ARG(PARSE_CAT_NEXT_, __VA_ARGS__) 1)) { \
+            PROFILE_REWIND(cat_s_, cat_match_); \
+            cat_match_ = NULL; \
+        } \
+        PROFILE_EXIT(cat_match_); })
+#define PARSE_CAT_NEXT_(p) \
+    p(cat_s_) != NULL &&
 
 #endif /* URI_PATH_FINDER_HOF_H */
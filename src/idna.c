@@ -0,0 +1,403 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "idna.h"
+#include "simd_kernels.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/* RFC 3492 section 5 */
+#define BASE         36
+#define TMIN         1
+#define TMAX         26
+#define SKEW         38
+#define DAMP         700
+#define INITIAL_BIAS 72
+#define INITIAL_N    0x80
+
+/* RFC 5890: a label is at most 63 bytes, so at most 63 code points */
+#define MAX_LABEL    63
+#define MAX_CODE     0x7FFFFFFFUL
+
+static const char ace_prefix[] = "xn--";
+
+/* The result is counted out in full even once the buffer is full, so
+ * that the caller learns the length it needs */
+typedef struct output {
+    char *buf;
+    size_t size;
+    size_t n;
+} output;
+
+static void put(output *o, char c) {
+    if (o->n < o->size) {
+        o->buf[o->n] = c;
+    }
+    o->n++;
+}
+
+static void put_str(output *o, const char *s, size_t len) {
+    if (o->n < o->size) {
+        memcpy(&o->buf[o->n], s, len < o->size - o->n ? len : o->size - o->n);
+    }
+    o->n += len;
+}
+
+static int hex_value(char c) {
+    return c >= '0' && c <= '9' ? c - '0' :
+           c >= 'A' && c <= 'F' ? c - 'A' + 10 :
+           c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+static int is_ace(const char *p, const char *end) {
+    size_t i = 0;
+    if (end - p < 4) {
+        return 0;
+    }
+    for (i = 0; i < 4 && (p[i] | 0x20) == ace_prefix[i]; i++);
+    return i == 4;
+}
+
+/* Find the first byte of a host that might need converting: from 0x80,
+ * a "%", or a "--" as in "xn--", a vector at a time, see simd.c */
+static const char *find_idna_special(const char *p, const char *end) {
+    return simd_active.find_idna_special(p, end);
+}
+
+/* letters, digits and "-", the only ASCII a label in ACE form can have */
+static int is_ldh(long c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-';
+}
+
+/* The next byte of a label, decoding pct-encoded ones.  A pct-encoded
+ * ASCII byte other than a letter, digit or "-", such as "%2F" or "%2E",
+ * can't be decoded into a host, so it's -1. */
+static int next_byte(const char **p, const char *end) {
+    const char *s = *p;
+    if (s[0] == '%' && end - s >= 3 && hex_value(s[1]) >= 0 && hex_value(s[2]) >= 0) {
+        int c = hex_value(s[1]) << 4 | hex_value(s[2]);
+        *p += 3;
+        return c < 0x80 && !is_ldh(c) ? -1 : c;
+    }
+    *p += 1;
+    return (unsigned char)s[0];
+}
+
+/* The next code point of a label, or -1 if it isn't well-formed UTF-8 */
+static long next_code_point(const char **p, const char *end) {
+    int c = next_byte(p, end);
+    int n = 0;
+    long cp = 0;
+    long min = 0;
+    if (c < 0x80) {
+        return c;
+    } else if (c >= 0xC2 && c <= 0xDF) {
+        n = 1; cp = c & 0x1F; min = 0x80;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        n = 2; cp = c & 0x0F; min = 0x800;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        n = 3; cp = c & 0x07; min = 0x10000;
+    } else {
+        return -1;
+    }
+    for (; n > 0; n--) {
+        if (*p >= end || ((c = next_byte(p, end)) & 0xC0) != 0x80) {
+            return -1;
+        }
+        cp = cp << 6 | (c & 0x3F);
+    }
+    if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        return -1;
+    }
+    return cp;
+}
+
+static void put_utf8(output *o, unsigned long cp) {
+    if (cp < 0x80) {
+        put(o, (char)cp);
+    } else if (cp < 0x800) {
+        put(o, (char)(0xC0 | cp >> 6));
+        put(o, (char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        put(o, (char)(0xE0 | cp >> 12));
+        put(o, (char)(0x80 | (cp >> 6 & 0x3F)));
+        put(o, (char)(0x80 | (cp & 0x3F)));
+    } else {
+        put(o, (char)(0xF0 | cp >> 18));
+        put(o, (char)(0x80 | (cp >> 12 & 0x3F)));
+        put(o, (char)(0x80 | (cp >> 6 & 0x3F)));
+        put(o, (char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+/* RFC 3492 section 6.1 */
+static unsigned long adapt(unsigned long delta, unsigned long points, int first) {
+    unsigned long k = 0;
+    delta = first ? delta / DAMP : delta / 2;
+    delta += delta / points;
+    for (k = 0; delta > ((BASE - TMIN) * TMAX) / 2; k += BASE) {
+        delta /= BASE - TMIN;
+    }
+    return k + (BASE - TMIN + 1) * delta / (delta + SKEW);
+}
+
+static unsigned long threshold(unsigned long k, unsigned long bias) {
+    return k <= bias ? TMIN : k >= bias + TMAX ? TMAX : k - bias;
+}
+
+static char encode_digit(unsigned long d) {
+    return (char)(d < 26 ? 'a' + d : '0' + d - 26);
+}
+
+static int decode_digit(char c) {
+    return c >= '0' && c <= '9' ? c - '0' + 26 :
+           c >= 'A' && c <= 'Z' ? c - 'A' :
+           c >= 'a' && c <= 'z' ? c - 'a' : -1;
+}
+
+/* RFC 3492 section 6.3.  With at most MAX_LABEL code points, delta
+ * can't overflow. */
+static void punycode_encode(const unsigned long *cp, size_t len, output *o) {
+    unsigned long n = INITIAL_N;
+    unsigned long delta = 0;
+    unsigned long bias = INITIAL_BIAS;
+    size_t h = 0;
+    size_t b = 0;
+    size_t j = 0;
+    for (j = 0; j < len; j++) {
+        if (cp[j] < 0x80) {
+            put(o, (char)cp[j]);
+            b++;
+        }
+    }
+    if (b > 0) {
+        put(o, '-');
+    }
+    for (h = b; h < len; delta++, n++) {
+        unsigned long m = MAX_CODE;
+        for (j = 0; j < len; j++) {
+            if (cp[j] >= n && cp[j] < m) {
+                m = cp[j];
+            }
+        }
+        delta += (m - n) * (h + 1);
+        n = m;
+        for (j = 0; j < len; j++) {
+            if (cp[j] < n) {
+                delta++;
+            } else if (cp[j] == n) {
+                unsigned long q = delta;
+                unsigned long k = 0;
+                for (k = BASE;; k += BASE) {
+                    unsigned long t = threshold(k, bias);
+                    if (q < t) {
+                        break;
+                    }
+                    put(o, encode_digit(t + (q - t) % (BASE - t)));
+                    q = (q - t) / (BASE - t);
+                }
+                put(o, encode_digit(q));
+                bias = adapt(delta, h + 1, h == b);
+                delta = 0;
+                h++;
+            }
+        }
+    }
+}
+
+/* RFC 3492 section 6.2, into at most MAX_LABEL code points.  Returns
+ * how many, or -1 if the input isn't valid Punycode. */
+static int punycode_decode(const char *p, const char *end, unsigned long *cp) {
+    unsigned long n = INITIAL_N;
+    unsigned long i = 0;
+    unsigned long bias = INITIAL_BIAS;
+    size_t len = 0;
+    const char *in = end;
+    const char *basic = p;
+    /* the basic code points are before the last "-", if any */
+    for (; in > p && in[-1] != '-'; in--);
+    if (in > p) {
+        for (; basic < in - 1; basic++) {
+            if (len == MAX_LABEL || (unsigned char)*basic >= 0x80) {
+                return -1;
+            }
+            cp[len++] = (unsigned char)*basic;
+        }
+    } else {
+        in = p;
+    }
+    /* a label of only basic code points isn't encoded */
+    if (in == end) {
+        return -1;
+    }
+    while (in < end) {
+        unsigned long old_i = i;
+        unsigned long w = 1;
+        unsigned long k = 0;
+        for (k = BASE;; k += BASE) {
+            int digit = in < end ? decode_digit(*in++) : -1;
+            unsigned long t = threshold(k, bias);
+            if (digit < 0 || (unsigned long)digit > (MAX_CODE - i) / w) {
+                return -1;
+            }
+            i += digit * w;
+            if ((unsigned long)digit < t) {
+                break;
+            }
+            if (w > MAX_CODE / (BASE - t)) {
+                return -1;
+            }
+            w *= BASE - t;
+        }
+        bias = adapt(i - old_i, len + 1, old_i == 0);
+        if (i / (len + 1) > MAX_CODE - n) {
+            return -1;
+        }
+        n += i / (len + 1);
+        i %= len + 1;
+        if (len == MAX_LABEL || n < 0x80 || n > 0x10FFFF || (n >= 0xD800 && n <= 0xDFFF)) {
+            return -1;
+        }
+        memmove(&cp[i + 1], &cp[i], (len - i) * sizeof(*cp));
+        cp[i++] = n;
+        len++;
+    }
+    return (int)len;
+}
+
+/* A label with UTF-8 or pct-encoded bytes.  If it decodes to ASCII, that
+ * is written as it is, otherwise as "xn--" and its Punycode, so then its
+ * ASCII has to be letters, digits and "-" as well. */
+static int label_to_ascii(const char *p, const char *end, output *o) {
+    unsigned long cp[MAX_LABEL];
+    size_t len = 0;
+    size_t start = o->n;
+    int ascii = 1;
+    while (p < end) {
+        long c = next_code_point(&p, end);
+        if (c < 0 || len == MAX_LABEL) {
+            return 0;
+        }
+        ascii = ascii && c < 0x80;
+        cp[len++] = (unsigned long)c;
+    }
+    if (ascii) {
+        size_t j = 0;
+        for (j = 0; j < len; j++) {
+            put(o, (char)cp[j]);
+        }
+    } else {
+        size_t j = 0;
+        for (j = 0; j < len; j++) {
+            if (cp[j] < 0x80 && !is_ldh((long)cp[j])) {
+                return 0;
+            }
+        }
+        put_str(o, ace_prefix, 4);
+        punycode_encode(cp, len, o);
+    }
+    return o->n - start <= MAX_LABEL;
+}
+
+static int label_to_unicode(const char *p, const char *end, output *o) {
+    unsigned long cp[MAX_LABEL];
+    int len = punycode_decode(p + 4, end, cp);
+    int j = 0;
+    if (len <= 0) {
+        return 0;
+    }
+    for (j = 0; j < len; j++) {
+        put_utf8(o, cp[j]);
+    }
+    return 1;
+}
+
+/* Converts the labels that need it, copies the rest, and finishes as
+ * the get_* functions do */
+static char *convert_host(const char *host, size_t len, char *buf, size_t *buf_len, int to_unicode) {
+    const char *end = host + len;
+    const char *p = host;
+    output o;
+    o.buf = buf;
+    o.size = *buf_len;
+    o.n = 0;
+    if (host == NULL) {
+        *buf_len = 0;
+        return NULL;
+    }
+    if (find_idna_special(host, end) != end) {
+        while (p <= end) {
+            const char *dot = memchr(p, '.', end - p);
+            const char *stop = dot != NULL ? dot : end;
+            int ok = 1;
+            if (to_unicode ? is_ace(p, stop) : find_idna_special(p, stop) != stop && !is_ace(p, stop)) {
+                ok = to_unicode ? label_to_unicode(p, stop, &o) : label_to_ascii(p, stop, &o);
+            } else {
+                put_str(&o, p, stop - p);
+            }
+            if (!ok) {
+                *buf_len = 0;
+                return NULL;
+            }
+            if (dot == NULL) {
+                break;
+            }
+            put(&o, '.');
+            p = dot + 1;
+        }
+    } else {
+        put_str(&o, host, len);
+    }
+    if (o.n >= *buf_len) {
+        *buf_len = o.n;
+        return NULL;
+    }
+    buf[o.n] = '\0';
+    return buf;
+}
+
+char *host_to_ascii(const char *host, size_t len, char *buf, size_t *buf_len) {
+    return convert_host(host, len, buf, buf_len, 0);
+}
+
+char *host_to_unicode(const char *host, size_t len, char *buf, size_t *buf_len) {
+    return convert_host(host, len, buf, buf_len, 1);
+}
+
+char *get_host_ascii(const URI *uri, char *buf, size_t *len) {
+    return host_to_ascii(uri->host, len_host(uri), buf, len);
+}
+
+char *get_host_unicode(const URI *uri, char *buf, size_t *len) {
+    return host_to_unicode(uri->host, len_host(uri), buf, len);
+}
@@ -0,0 +1,210 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "metrics.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+/* Threads past this many at once share one more slot */
+#ifndef METRICS_THREADS
+#define METRICS_THREADS 32
+#endif
+
+/* The first bin holds everything under 2^METRICS_MIN_SHIFT ns */
+#define METRICS_MIN_SHIFT 6
+#define METRICS_SUB_SHIFT 2
+
+int metrics_enabled = 0;
+
+/* A slot is owned by one thread from its first record until it exits,
+ * when the key's destructor gives it back.  The counts stay in it, so
+ * the sums only ever increase, and the next thread to take it carries
+ * on from them.  The last slot is never owned. */
+typedef struct metrics_slot {
+    metrics_snapshot counts;
+    int owned;
+} metrics_slot;
+
+static metrics_slot slots[METRICS_THREADS + 1];
+/* One past the highest slot ever taken, so snapshots read no further */
+static unsigned int slots_used = 0;
+static pthread_once_t slot_once = PTHREAD_ONCE_INIT;
+static pthread_key_t slot_key;
+static __thread metrics_snapshot *slot = NULL;
+static __thread int slot_shared = 0;
+
+static const char *scheme_names[METRICS_SCHEMES] = {
+    "other", "http", "https", "ws", "wss", "ftp", "file", "mailto", "urn", "data", "tel",
+};
+
+static const char *reason_names[METRICS_REASONS] = {
+    "scheme", "colon", "authority", "path", "query", "fragment", "number", "parameters", "end",
+};
+
+void metrics_enable(int on) {
+    __atomic_store_n(&metrics_enabled, on, __ATOMIC_RELAXED);
+}
+
+unsigned long long metrics_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+metrics_scheme metrics_scheme_of(const char *scheme, size_t len) {
+    int i = 0;
+    for (i = METRICS_HTTP; i < METRICS_TEL; i++) {
+        const char *name = scheme_names[i];
+        size_t j = 0;
+        for (j = 0; j < len && name[j] != '\0' && (scheme[j] | 0x20) == name[j]; j++);
+        if (j == len && name[j] == '\0') {
+            return (metrics_scheme)i;
+        }
+    }
+    return METRICS_OTHER;
+}
+
+static unsigned int length_bucket(size_t length) {
+    unsigned int b = 0;
+    for (b = 0; b + 1 < METRICS_LENGTHS && length >= metrics_length_upper(b); b++);
+    return b;
+}
+
+static unsigned int latency_bin(unsigned long long ns) {
+    unsigned int shift = 0;
+    unsigned int bin = 0;
+    if (ns < (1ULL << METRICS_MIN_SHIFT)) {
+        return 0;
+    }
+    shift = 63 - __builtin_clzll(ns);
+    bin = 1 + ((shift - METRICS_MIN_SHIFT) << METRICS_SUB_SHIFT) +
+          ((ns >> (shift - METRICS_SUB_SHIFT)) & ((1u << METRICS_SUB_SHIFT) - 1));
+    return bin < METRICS_BINS ? bin : METRICS_BINS - 1;
+}
+
+static void slot_release(void *owned) {
+    __atomic_store_n(&((metrics_slot *)owned)->owned, 0, __ATOMIC_RELEASE);
+}
+
+static void slot_key_create(void) {
+    pthread_key_create(&slot_key, slot_release);
+}
+
+/* Take the first free slot, or share the last one if there's none */
+static void slot_take(void) {
+    unsigned int i = 0;
+    unsigned int used = 0;
+    for (i = 0; i < METRICS_THREADS; i++) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&slots[i].owned, &expected, 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            pthread_once(&slot_once, slot_key_create);
+            pthread_setspecific(slot_key, &slots[i]);
+            break;
+        }
+    }
+    used = __atomic_load_n(&slots_used, __ATOMIC_RELAXED);
+    while (used < i + 1 &&
+           !__atomic_compare_exchange_n(&slots_used, &used, i + 1, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    slot = &slots[i].counts;
+    slot_shared = i == METRICS_THREADS;
+}
+
+/* An owned slot has one writer, so it needs no read-modify-write */
+static void slot_count(unsigned long *counter) {
+    if (slot_shared) {
+        __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+    }
+}
+
+void metrics_record(metrics_scheme scheme, size_t length, int reason, unsigned long long start) {
+    unsigned long long ns = metrics_now() - start;
+    unsigned int bucket = length_bucket(length);
+    if (slot == NULL) {
+        slot_take();
+    }
+    if (reason < 0) {
+        slot_count(&slot->successes[scheme][bucket]);
+    } else {
+        slot_count(&slot->failures[scheme][reason]);
+    }
+    slot_count(&slot->latency[scheme][bucket][latency_bin(ns)]);
+}
+
+void metrics_snapshot_take(metrics_snapshot *snapshot) {
+    unsigned int used = __atomic_load_n(&slots_used, __ATOMIC_RELAXED);
+    unsigned int i = 0;
+    size_t j = 0;
+    memset(snapshot, 0, sizeof(*snapshot));
+    for (i = 0; i < used; i++) {
+        const unsigned long *from = &slots[i].counts.successes[0][0];
+        unsigned long *to = &snapshot->successes[0][0];
+        /* The struct is nothing but counters */
+        for (j = 0; j < sizeof(*snapshot) / sizeof(unsigned long); j++) {
+            to[j] += __atomic_load_n(&from[j], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+const char *metrics_scheme_name(metrics_scheme scheme) {
+    return scheme >= 0 && scheme < METRICS_SCHEMES ? scheme_names[scheme] : NULL;
+}
+
+const char *metrics_reason_name(metrics_reason reason) {
+    return reason >= 0 && reason < METRICS_REASONS ? reason_names[reason] : NULL;
+}
+
+size_t metrics_length_upper(unsigned int length) {
+    return length + 1 < METRICS_LENGTHS ? (size_t)16 << length : (size_t)-1;
+}
+
+unsigned long long metrics_bin_upper(unsigned int bin) {
+    unsigned int shift = 0;
+    unsigned int sub = 0;
+    if (bin == 0) {
+        return 1ULL << METRICS_MIN_SHIFT;
+    }
+    if (bin + 1 >= METRICS_BINS) {
+        return ~0ULL;
+    }
+    shift = METRICS_MIN_SHIFT + ((bin - 1) >> METRICS_SUB_SHIFT);
+    sub = (bin - 1) & ((1u << METRICS_SUB_SHIFT) - 1);
+    return (1ULL << shift) + ((unsigned long long)(sub + 1) << (shift - METRICS_SUB_SHIFT));
+}
@@ -0,0 +1,90 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "profile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static profile_rule *rules = NULL;
+
+/* Called by the rules the first time they run */
+void profile_register(profile_rule *rule) {
+    if (__atomic_exchange_n(&rule->registered, 1, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+    rule->next = __atomic_load_n(&rules, __ATOMIC_ACQUIRE);
+    while (!__atomic_compare_exchange_n(&rules, &rule->next, rule, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+}
+
+const profile_rule *profile_rules(void) {
+    return __atomic_load_n(&rules, __ATOMIC_ACQUIRE);
+}
+
+static int same_rule(const profile_rule *a, const profile_rule *b) {
+    return strcmp(a->name, b->name) == 0 && strcmp(a->file, b->file) == 0;
+}
+
+void profile_dump(FILE *f) {
+    const profile_rule *r = NULL;
+    fprintf(f, "file\trule\tcalls\tsuccesses\tfailures\trewound\n");
+    for (r = profile_rules(); r != NULL; r = r->next) {
+        const profile_rule *o = NULL;
+        unsigned long successes = 0;
+        unsigned long failures = 0;
+        unsigned long rewound = 0;
+        /* Entries for the same combinator are combined at the first */
+        for (o = profile_rules(); o != r && !same_rule(o, r); o = o->next);
+        if (o != r) {
+            continue;
+        }
+        for (o = r; o != NULL; o = o->next) {
+            if (same_rule(o, r)) {
+                successes += o->successes;
+                failures += o->failures;
+                rewound += o->rewound;
+            }
+        }
+        fprintf(f, "%s\t%s\t%lu\t%lu\t%lu\t%lu\n", r->file, r->name,
+                successes + failures, successes, failures, rewound);
+    }
+}
+
+void profile_reset(void) {
+    profile_rule *r = NULL;
+    for (r = __atomic_load_n(&rules, __ATOMIC_ACQUIRE); r != NULL; r = r->next) {
+        __atomic_store_n(&r->successes, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&r->failures, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&r->rewound, 0, __ATOMIC_RELAXED);
+    }
+}
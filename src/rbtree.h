@@ -36,6 +36,7 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include <string.h>
+#include <strings.h>
 
 typedef enum color {
     red, black
@@ -149,6 +150,16 @@ static void tree_rotate_left(tree *x) {
     }
 }
 
+/* Names are ordered ignoring case, as RFC 3966 compares parameter names,
+ * then shorter first, reading neither past its own length */
+static int tree_compare(const char *a, size_t a_len, const char *b, size_t b_len) {
+    int cmp = strncasecmp(a, b, a_len < b_len ? a_len : b_len);
+    if (cmp != 0) {
+        return cmp;
+    }
+    return a_len < b_len ? -1 : a_len > b_len;
+}
+
 static bool tree_insert(const char *needle, size_t needle_len, arena *a) {
     tree *which = arena_alloc(a);
     if (which == NULL) {
@@ -168,17 +179,12 @@ static bool tree_insert(const char *needle, size_t needle_len, arena *a) {
     tree *previous = NULL;
     while (*current != NULL) {
         previous = *current;
-        int cmp = strncmp(needle, previous->v, needle_len);
+        int cmp = tree_compare(needle, needle_len, previous->v, previous->v_len);
         if (cmp == 0) {
-            if (needle_len == previous->v_len) {
-                /* Already in the table! Couldn't insert. */
-                return false;
-            }
-            current = needle_len < previous->v_len ?
-                      &previous->lhs : &previous->rhs;
-        } else {
-            current = cmp < 0 ? &previous->lhs : &previous->rhs;
+            /* Already in the table! Couldn't insert. */
+            return false;
         }
+        current = cmp < 0 ? &previous->lhs : &previous->rhs;
     }
     which->par = previous;
     which->color = red;
@@ -32,38 +32,56 @@
 
 #include "hof.h"
 #include "chars.h"
+#include "metrics.h"
 #include "rfc_3966.h"
+#include "charset.h"
 #include "rbtree.h"
 #define RBTREE_SIZE 1000
 
 #include <stddef.h>
+#include <string.h>
 
 #define MAKE_TEL_LEN_FROM_PARS_LEN(field) \
     size_t len_par_##field(const Tel *t) { \
         return len_##field(&t->pars); \
     }
 
+#if URI_CHARSET == URI_CHARSET_ASCII
 MAKE_LEN(Tel, global_number, data->number_stop)
 MAKE_LEN(Tel, local_number,  data->number_stop)
 MAKE_LEN(Pars, ext, data->ext_stop)
 MAKE_LEN(Pars, isdn, data->isdn_stop)
 MAKE_LEN(Pars, context, data->context_stop)
+MAKE_LEN(Pars, npdi, data->npdi_stop)
+MAKE_LEN(Pars, rn, data->rn_stop)
+MAKE_LEN(Pars, cic, data->cic_stop)
 MAKE_LEN(Pars, pars_1, data->pars_1_stop)
 MAKE_LEN(Pars, pars_2, data->pars_2_stop)
 MAKE_LEN(Pars, pars_3, data->pars_3_stop)
 MAKE_LEN(Pars, pars_4, data->pars_4_stop)
+MAKE_LEN(Pars, pars_5, data->pars_5_stop)
+MAKE_LEN(Pars, pars_6, data->pars_6_stop)
+MAKE_LEN(Pars, pars_7, data->pars_7_stop)
 
 MAKE_TEL_LEN_FROM_PARS_LEN(ext)
 MAKE_TEL_LEN_FROM_PARS_LEN(isdn)
 MAKE_TEL_LEN_FROM_PARS_LEN(context)
+MAKE_TEL_LEN_FROM_PARS_LEN(npdi)
+MAKE_TEL_LEN_FROM_PARS_LEN(rn)
+MAKE_TEL_LEN_FROM_PARS_LEN(cic)
 MAKE_TEL_LEN_FROM_PARS_LEN(pars_1)
 MAKE_TEL_LEN_FROM_PARS_LEN(pars_2)
 MAKE_TEL_LEN_FROM_PARS_LEN(pars_3)
 MAKE_TEL_LEN_FROM_PARS_LEN(pars_4)
+MAKE_TEL_LEN_FROM_PARS_LEN(pars_5)
+MAKE_TEL_LEN_FROM_PARS_LEN(pars_6)
+MAKE_TEL_LEN_FROM_PARS_LEN(pars_7)
 
 size_t len_pars(const Tel *t) {
     return len_pars_1(&t->pars) + len_pars_2(&t->pars) +
-           len_pars_3(&t->pars) + len_pars_4(&t->pars);
+           len_pars_3(&t->pars) + len_pars_4(&t->pars) +
+           len_pars_5(&t->pars) + len_pars_6(&t->pars) +
+           len_pars_7(&t->pars);
 }
 
 #define MAKE_TEL_GET_FROM_PARS_GET(field) \
@@ -76,165 +94,197 @@ MAKE_GETTER(Tel, local_number)
 MAKE_GETTER(Pars, ext)
 MAKE_GETTER(Pars, isdn)
 MAKE_GETTER(Pars, context)
+MAKE_GETTER(Pars, npdi)
+MAKE_GETTER(Pars, rn)
+MAKE_GETTER(Pars, cic)
 MAKE_GETTER(Pars, pars_1)
 MAKE_GETTER(Pars, pars_2)
 MAKE_GETTER(Pars, pars_3)
 MAKE_GETTER(Pars, pars_4)
+MAKE_GETTER(Pars, pars_5)
+MAKE_GETTER(Pars, pars_6)
+MAKE_GETTER(Pars, pars_7)
 
 MAKE_TEL_GET_FROM_PARS_GET(ext)
 MAKE_TEL_GET_FROM_PARS_GET(isdn)
 MAKE_TEL_GET_FROM_PARS_GET(context)
+MAKE_TEL_GET_FROM_PARS_GET(npdi)
+MAKE_TEL_GET_FROM_PARS_GET(rn)
+MAKE_TEL_GET_FROM_PARS_GET(cic)
 MAKE_TEL_GET_FROM_PARS_GET(pars_1)
 MAKE_TEL_GET_FROM_PARS_GET(pars_2)
 MAKE_TEL_GET_FROM_PARS_GET(pars_3)
 MAKE_TEL_GET_FROM_PARS_GET(pars_4)
+MAKE_TEL_GET_FROM_PARS_GET(pars_5)
+MAKE_TEL_GET_FROM_PARS_GET(pars_6)
+MAKE_TEL_GET_FROM_PARS_GET(pars_7)
 
 char *get_pars(const Tel *t, char *buf, size_t *len) {
+    /* The runs are filled in order, so they end at the first NULL one */
+    char *(*gets[])(const Pars *, char *, size_t *) = {
+        get_pars_1, get_pars_2, get_pars_3, get_pars_4, get_pars_5, get_pars_6, get_pars_7,
+    };
+    size_t (*lens[])(const Pars *) = {
+        len_pars_1, len_pars_2, len_pars_3, len_pars_4, len_pars_5, len_pars_6, len_pars_7,
+    };
     size_t f_len = len_pars(t);
-    if (f_len >= *len) {
+    size_t used = 0;
+    size_t i = 0;
+    if (t->pars.pars_1 == NULL || f_len >= *len) {
         *len = f_len;
         return NULL;
     }
-    size_t original_length = *len;
-    if (get_pars_1(&t->pars, buf, len) == NULL) {
-        return NULL;
-    }
-    size_t tmplen = original_length - *len;
-    if (get_pars_2(&t->pars, &buf[*len], &tmplen) != NULL) {
-        *len = *len + tmplen;
-        tmplen = original_length - *len;
-        if (get_pars_3(&t->pars, &buf[*len], &tmplen) != NULL) {
-            *len = *len + tmplen;
-            tmplen = original_length - *len;
-            if (get_pars_4(&t->pars, &buf[*len], &tmplen) != NULL) {
-                *len = *len + tmplen;
-            }
+    for (i = 0; i < sizeof(gets) / sizeof(gets[0]); i++) {
+        size_t tmplen = *len - used;
+        if (gets[i](&t->pars, &buf[used], &tmplen) == NULL) {
+            break;
         }
+        used += lens[i](&t->pars);
     }
     return buf;
 }
+#endif /* URI_CHARSET_ASCII */
 
 /* alphanum = ALPHA / DIGIT */
 static const char *parse_alphanum(const char **s) {
-    return parse_opt(s, 2, parse_alpha, parse_digit);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_alpha, parse_digit));
 }
 
 /* reserved = ";" / "/" / "?" / ":" / "@" / "&" /
  *            "=" / "+" / "$" / "," */
 static const char *parse_reserved(const char **s) {
-    return parse_opt(s, 9,  parse_fwd_slash, parse_question,
-                            parse_colon, parse_atsymbol, parse_ampersand,
-                            parse_equal, parse_plus, parse_dollar, parse_comma);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s,  parse_fwd_slash, parse_question,
+                                               parse_colon, parse_atsymbol, parse_ampersand,
+                                               parse_equal, parse_plus, parse_dollar, parse_comma));
 }
 
 /* mark = "-" / "_" / "." / "!" / "~" / "*" /
  *        "'" / "(" / ")" */
 static const char *parse_mark(const char **s) {
-    return parse_opt(s, 9, parse_dash, parse_underscore, parse_dot,
-                           parse_exclamation, parse_tilde, parse_star,
-                           parse_singlequote, parse_lparens, parse_rparens);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_dash, parse_underscore, parse_dot,
+                                              parse_exclamation, parse_tilde, parse_star,
+                                              parse_singlequote, parse_lparens, parse_rparens));
 }
 
 /* unreserved = alphanum / mark */
 static const char *parse_unreserved(const char **s) {
-    return parse_opt(s, 2, parse_alphanum, parse_mark);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_alphanum, parse_mark));
 }
 
 /* pct-encoded = "%" HEXDIG HEXDIG */
 static const char *parse_pct_encoded(const char **s) {
-    return parse_cat(s, 3, parse_percent, parse_hexdig, parse_hexdig);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_CAT(s, parse_percent, parse_hexdig, parse_hexdig));
 }
 
 /* uric = reserved / unreserved / pct-encoded */
 static const char *parse_uric(const char **s) {
-    return parse_opt(s, 3, parse_reserved, parse_unreserved, parse_pct_encoded);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_reserved, parse_unreserved, parse_pct_encoded));
 }
 
 /* visual-separator = "-" / "." / "(" / ")" */
 static const char *parse_visual_separator(const char **s) {
-    return parse_opt(s, 4, parse_dash, parse_dot, parse_lparens, parse_rparens);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_dash, parse_dot, parse_lparens, parse_rparens));
 }
 
 /* phonedigit-hex = HEXDIG / "*" / "#" / [ visual-separator ] */
 static const char *parse_phonedigit_hex(const char **s) {
-    return parse_opt(s, 4, parse_hexdig, parse_star, parse_pound,
-                           /* brackets make no sense here since
-                              it's already optional with the
-                              brackets, rules invoking this one
-                              can simply loop forever */
-                           parse_visual_separator);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_hexdig, parse_star, parse_pound,
+                                              /* brackets make no sense here since
+                                                 it's already optional with the
+                                                 brackets, rules invoking this one
+                                                 can simply loop forever */
+                                              parse_visual_separator));
 }
 
 /* phonedigit = DIGIT / [ visual-separator ] */
 static const char *parse_phonedigit(const char **s) {
-    return parse_opt(s, 2, parse_digit,
-                           /* brackets make no sense here since
-                              it's already optional with the
-                              brackets, rules invoking this one
-                              can simply loop forever */
-                           parse_visual_separator);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_digit,
+                                              /* brackets make no sense here since
+                                                 it's already optional with the
+                                                 brackets, rules invoking this one
+                                                 can simply loop forever */
+                                              parse_visual_separator));
 }
 
 /* param-unreserved = "[" / "]" / "/" / ":" / "&" / "+" / "$" */
 static const char *parse_param_unreserved(const char **s) {
-    return parse_opt(s, 7, parse_lbracket, parse_rbracket, parse_fwd_slash,
-                           parse_colon, parse_ampersand, parse_plus,
-                           parse_dollar);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_lbracket, parse_rbracket, parse_fwd_slash,
+                                              parse_colon, parse_ampersand, parse_plus,
+                                              parse_dollar));
 }
 
 /* paramchar = param-unreserved / unreserved / pct-encoded */
 static const char *parse_paramchar(const char **s) {
-    return parse_opt(s, 3, parse_param_unreserved, parse_unreserved, parse_pct_encoded);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_param_unreserved, parse_unreserved, parse_pct_encoded));
 }
 
 /* pvalue = 1*paramchar */
 static const char *parse_pvalue(const char **s) {
-    return parse_n_star(s, 1, parse_paramchar);
+    PROFILE_RULE();
+    return PROFILE_EXIT(parse_n_star(s, 1, parse_paramchar));
 }
 
 /* pname = 1*( alphanum / "-" ) */
 static const char *parse_pname_char(const char **s) {
-    return parse_opt(s, 2, parse_alphanum, parse_dash);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_alphanum, parse_dash));
 }
 static const char *parse_pname(const char **s) {
-    return parse_n_star(s, 1, parse_pname_char);
+    PROFILE_RULE();
+    return PROFILE_EXIT(parse_n_star(s, 1, parse_pname_char));
 }
 
 /* parameter = ";" pname ["=" pvalue ] */
 static const char *parse_parameter(const char **s, const char **pnend) {
+    PROFILE_RULE();
     /* Handle ; below */
     const char *match = parse_pname(s);
     *pnend = NULL;
     if (match != NULL) {
         *pnend = *s;
-        parse_cat(s, 2, parse_equal, parse_pvalue);
+        PARSE_CAT(s, parse_equal, parse_pvalue);
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* toplabel = ALPHA / ALPHA *( alphanum / "-" ) alphanum
  * domainlabel = alphanum / alphanum *( alphanum / "-" ) alphanum */
 static const char *parse_label_char(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_pname(s);
     if (match != NULL) {
-        /* recheck that the last character isn't a dash */
-        *s = (*s) - 1;
+        /* recheck that the last character isn't a dash,
+           which only ever steps back over one character */
+        PROFILE_REWIND(s, (*s) - 1);
         if (parse_alphanum(s) == NULL) {
-            *s = match;
+            PROFILE_REWIND(s, match);
         }
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 static const char *parse_domainlabel(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_alphanum(s);
     if (match != NULL) {
         parse_label_char(s);
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* domainname = *( domainlabel "." ) toplabel [ "." ] */
 static const char *parse_domainname(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_domainlabel(s);
     const char *cur = match;
     const char *last_potential_toplabel = NULL;
@@ -255,30 +305,33 @@ static const char *parse_domainname(const char **s) {
         }
         cur = parse_domainlabel(s);
     }
-    /* Rewind to the last_toplabel and stop there */
-    *s = last_potential_toplabel_stop;
+    /* Rewind to the last_toplabel and stop there.  The labels are
+       scanned in one pass, so this rewinds once and never rescans. */
+    PROFILE_REWIND(s, last_potential_toplabel_stop);
     if (last_potential_toplabel == NULL) {
         /* If a last_toplabel was never found, fail overall */
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* local-number-digits = *phonedigit-hex (HEXDIG / "*" / "#") *phonedigit-hex */
 static const char *parse_local_number_digits(const char **s) {
+    PROFILE_RULE();
     /* Due to ambiguity of the mandatory digit / * / # inside the
        phonedigit-hex visual separators have to be removed so... */
     const char *match = parse_n_star(s, 0, parse_visual_separator);
     if (/* ... on succeess, the first character must be a digit / * / #   */
         parse_n_star(s, 1, parse_phonedigit_hex) == NULL) {
-        *s = match;
+        PROFILE_REWIND(s, match);
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* global-number-digits = "+" *phonedigit DIGIT *phonedigit */
 static const char *parse_global_number_digits(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_plus(s);
     if (match != NULL &&
         /* Due to ambiguity of the mandatory digit inside the
@@ -286,64 +339,165 @@ static const char *parse_global_number_digits(const char **s) {
         parse_n_star(s, 0, parse_visual_separator) != NULL &&
         /* ... on succeess, the first character must be a digit */
         parse_n_star(s, 1, parse_phonedigit) == NULL) {
-        *s = match;
+        PROFILE_REWIND(s, match);
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 
 /* descriptor = domainname / global-number-digits */
 static const char *parse_descriptor(const char **s) {
-    return parse_opt(s, 2, parse_domainname, parse_global_number_digits);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_domainname, parse_global_number_digits));
 }
 
 /* context = ";phone-context=" descriptor */
 static const char *parse_context(const char **s, const char **pnend) {
+    PROFILE_RULE();
     /* Handle ; below */
+    const char *start = *s;
     const char *match = parse_str(s, "phone-context");
     *pnend = *s;
     if (match == NULL || parse_char(s, '=') == NULL ||
                          parse_descriptor(s) == NULL) {
+        PROFILE_REWIND(s, start);
         *pnend = NULL;
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* extension = ";ext=" 1*phonedigit */
 static const char *parse_extension(const char **s, const char **pnend) {
+    PROFILE_RULE();
     /* Handle ; below */
+    const char *start = *s;
     const char *match = parse_str(s, "ext");
     *pnend = *s;
     if (match == NULL || parse_char(s, '=') == NULL ||
                          parse_n_star(s, 1, parse_phonedigit) == NULL) {
+        PROFILE_REWIND(s, start);
         *pnend = NULL;
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* isdn-subaddress = ";isub=" 1*uric */
 static const char *parse_isdn_subaddress(const char **s, const char **pnend) {
+    PROFILE_RULE();
     /* Handle ; below */
+    const char *start = *s;
     const char *match = parse_str(s, "isub");
     *pnend = *s;
     if (match == NULL || parse_char(s, '=') == NULL ||
                          parse_n_star(s, 1, parse_uric) == NULL) {
+        PROFILE_REWIND(s, start);
+        *pnend = NULL;
+        match = NULL;
+    }
+    return PROFILE_EXIT(match);
+}
+
+/* The number portability and carrier parameters are from RFC 4694 */
+
+/* hex-phonedigit = HEXDIG / visual-separator */
+static const char *parse_hex_phonedigit(const char **s) {
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_hexdig, parse_visual_separator));
+}
+
+/* global-hex-digits = "+" 1*3(DIGIT) *hex-phonedigit */
+static const char *parse_global_hex_digits(const char **s) {
+    PROFILE_RULE();
+    const char *match = parse_plus(s);
+    if (match != NULL) {
+        if (parse_n_to_m(s, 1, 3, parse_digit) == NULL) {
+            PROFILE_REWIND(s, match);
+            match = NULL;
+        } else {
+            parse_n_star(s, 0, parse_hex_phonedigit);
+        }
+    }
+    return PROFILE_EXIT(match);
+}
+
+/* global-rn = global-hex-digits
+ * local-rn = 1*hex-phonedigit rn-context
+ * and likewise for cic.  The rn-context and cic-context are left to
+ * parse_parameter, since they are separate parameters. */
+static const char *parse_hex_digits(const char **s) {
+    PROFILE_RULE();
+    const char *match = parse_global_hex_digits(s);
+    if (match == NULL) {
+        match = parse_n_star(s, 1, parse_hex_phonedigit);
+    }
+    return PROFILE_EXIT(match);
+}
+
+/* npdi = ";npdi" */
+static const char *parse_npdi(const char **s, const char **pnend) {
+    PROFILE_RULE();
+    /* Handle ; below */
+    const char *start = *s;
+    const char *match = parse_str(s, "npdi");
+    const char *tmp = *s;
+    *pnend = *s;
+    /* It takes no value, and it mustn't be the start of a longer pname */
+    if (match == NULL || **s == '=' || parse_alphanum(&tmp) != NULL ||
+                                       parse_dash(&tmp) != NULL) {
+        PROFILE_REWIND(s, start);
+        *pnend = NULL;
+        match = NULL;
+    }
+    return PROFILE_EXIT(match);
+}
+
+/* rn = ";rn=" ( global-rn / local-rn ) */
+static const char *parse_rn(const char **s, const char **pnend) {
+    PROFILE_RULE();
+    /* Handle ; below */
+    const char *start = *s;
+    const char *match = parse_str(s, "rn");
+    *pnend = *s;
+    if (match == NULL || parse_char(s, '=') == NULL ||
+                         parse_hex_digits(s) == NULL) {
+        PROFILE_REWIND(s, start);
+        *pnend = NULL;
+        match = NULL;
+    }
+    return PROFILE_EXIT(match);
+}
+
+/* cic = ";cic=" ( global-cic / local-cic ) */
+static const char *parse_cic(const char **s, const char **pnend) {
+    PROFILE_RULE();
+    /* Handle ; below */
+    const char *start = *s;
+    const char *match = parse_str(s, "cic");
+    *pnend = *s;
+    if (match == NULL || parse_char(s, '=') == NULL ||
+                         parse_hex_digits(s) == NULL) {
+        PROFILE_REWIND(s, start);
         *pnend = NULL;
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
-/* par = parameter / extension / isdn-subaddress */
-static const char *parse_par(const char **s, const char **pnend, const char **ext, const char **isdn, const char **context) {
+/* par = parameter / extension / isdn-subaddress
+ * par =/ npdi / rn / cic  (RFC 4694) */
+static const char *parse_par(const char **s, const char **pnend, const char **ext, const char **isdn, const char **context, const char **npdi, const char **rn, const char **cic) {
+    PROFILE_RULE();
     /* Handle ; here instead of in the individual rules */
     const char *match = parse_semicolon(s);
     *ext = NULL;
     *isdn = NULL;
     *context = NULL;
+    *npdi = NULL;
+    *rn = NULL;
+    *cic = NULL;
     if (match != NULL &&
         /* On first glance this is inefficient, but
          * each special parameter probably fails quickly,
@@ -358,7 +512,13 @@ static const char *parse_par(const char **s, const char **pnend, const char **ex
          * alphanum, in which case it would succeed in
          * parse_parameter.  Since these fail on the first
          * character after =, the reparse is minimal.
-         * Admittedly this edge case is a mess. */
+         * Admittedly this edge case is a mess.
+         *
+         * At worst a value is read once by the special
+         * parameter whose name matched and once more by
+         * parse_parameter, since the names are distinct and
+         * every other alternative fails within its name, so
+         * each parameter is scanned at most twice. */
         ((*ext = parse_extension(s, pnend)) == NULL) &&
         ((*isdn = parse_isdn_subaddress(s,pnend)) == NULL) &&
         /* Although context is not a part of the par rule
@@ -366,15 +526,20 @@ static const char *parse_par(const char **s, const char **pnend, const char **ex
            otherwise get parsed by parse_parameter, which
            would require reparsing. */
         ((*context = parse_context(s, pnend)) == NULL) &&
+        /* Likewise the RFC 4694 parameters are recognized here
+           so their values need not be tokenized again later. */
+        ((*npdi = parse_npdi(s, pnend)) == NULL) &&
+        ((*rn = parse_rn(s, pnend)) == NULL) &&
+        ((*cic = parse_cic(s, pnend)) == NULL) &&
         /* Generic parameter is parsed last unlike in the
            rule, since otherwise the special parameters
            can't be efficiently identified. */
         (parse_parameter(s, pnend) == NULL)) {
-        *s = match;
+        PROFILE_REWIND(s, match);
         pnend = NULL;
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 #define max(a, b) ({ \
@@ -382,8 +547,69 @@ static const char *parse_par(const char **s, const char **pnend, const char **ex
         __typeof__(b) _b = (b); \
         _b < _a ? _a : _b; })
 
-/* Helper for parse_local_number and parse_global_number */
-static const char *parse_par_star(const char **s, Pars *result) {
+/* The names of the parameters seen so far, for parse_par_star and
+ * is_valid_telephone.  Per the spec, each parameter name must not appear
+ * more than once, and names are compared ignoring case, as tel_equal
+ * compares them.  Each insert compares at most 2*log2(RBTREE_SIZE)
+ * names, each read no further than its own length, so this stays linear
+ * as well.  RBTREE_SIZE should be enough, right?  The stack is left
+ * uninitialized since arena_alloc initializes each entry as it hands it
+ * out. */
+typedef struct par_names {
+    tree stack[RBTREE_SIZE];
+    arena ar;
+#ifdef RFC_3966_CHECK_ORDER
+    int prev_rank;
+    const char *prev_name;
+    size_t prev_len;
+#endif /* RFC_3966_CHECK_ORDER */
+} par_names;
+
+static void par_names_init(par_names *names) {
+    names->ar.size = RBTREE_SIZE;
+    names->ar.entries = 0;
+    names->ar.stack = names->stack;
+#ifdef RFC_3966_CHECK_ORDER
+    names->prev_rank = 0;
+    names->prev_name = NULL;
+    names->prev_len = 0;
+#endif /* RFC_3966_CHECK_ORDER */
+}
+
+/* Adds the next parameter's name, where rank is 0 for the extension and
+ * isdn-subaddress, 1 for the context and 2 for any other parameter.
+ * Returns false if the name was seen before, or is out of order. */
+static bool par_names_add(par_names *names, const char *name, size_t name_len, int rank) {
+    if (!tree_insert(name, name_len, &names->ar)) {
+        return false;
+    }
+#ifdef RFC_3966_CHECK_ORDER
+    /* NOTE: Per the spec, compliant parsers must strictly check that the
+       'isdn-subaddress' or 'extension' parameters appear first, if
+       present, followed by the 'context' parameter, if present, followed
+       by any other parameters in lexicographical order.  However,
+       for flexibility, we only check these restrictions if enabled.
+       Names are ordered as the duplicate check above orders them. */
+    if (rank < names->prev_rank ||
+        (rank == 2 && names->prev_name != NULL &&
+         tree_compare(names->prev_name, names->prev_len, name, name_len) > 0)) {
+        return false;
+    }
+    names->prev_rank = rank;
+    if (rank == 2) {
+        names->prev_name = name;
+        names->prev_len = name_len;
+    }
+#else
+    (void)rank;
+#endif /* RFC_3966_CHECK_ORDER */
+    return true;
+}
+
+/* Helper for parse_local_number and parse_global_number.
+ * On failure, fail is set to the parameter that made the list invalid. */
+static const char *parse_par_star(const char **s, Pars *result, const char **fail) {
+    PROFILE_RULE();
     /* Technically, RFC5341 constrains the possible parameters.
        We ignore that, to future proof.  Handling these requires
        extra considerations not covered by this parser. */
@@ -395,55 +621,49 @@ static const char *parse_par_star(const char **s, Pars *result) {
     const char *etmp = NULL;
     const char *itmp = NULL;
     const char *ctmp = NULL;
-    tree stack[RBTREE_SIZE] = {0}; /* RBTREE_SIZE should be enough, right? */
-    arena ar = { .size = RBTREE_SIZE, .entries = 0, .stack = stack };
-    while ((ptmp = parse_par(s, &pnend, &etmp, &itmp, &ctmp)) != NULL) {
-        /* Per the spec, each parameter name must not appear more than once. */
-        if (!tree_insert(ptmp + 1, pnend - ptmp - 1, &ar)) {
-            /* The parser found a duplicate parameter */
-            *s = match;
-            *result = result_null;
-            match = NULL;
-            break;
-        }
-#ifdef RFC_3966_CHECK_ORDER
-        /* NOTE: Per the spec, compliant parsers must strictly check that the
-           'isdn-subaddress' or 'extension' parameters appear first, if
-           present, followed by the 'context' parameter, if present, followed
-           by any other parameters in lexicographical order.  However,
-           for flexibility, we only check these restrictions if enabled. */
-        if (result->context != NULL && result->context < result->ext ||
-            result->context != NULL && result->context < result->isdn ||
-            result->pars_1  != NULL && result->pars_1  < result->ext ||
-            result->pars_1  != NULL && result->pars_1  < result->isdn ||
-            result->pars_1  != NULL && result->context < result->context ||
-            result->pars_2  != NULL ||
-            result->pars_3  != NULL ||
-            result->pars_4  != NULL ||
-            tree_max(&stack[0])->v != ptmp) {
-            *s = match;
+    const char *ntmp = NULL;
+    const char *rtmp = NULL;
+    const char *ttmp = NULL;
+    par_names names;
+    par_names_init(&names);
+    while ((ptmp = parse_par(s, &pnend, &etmp, &itmp, &ctmp, &ntmp, &rtmp, &ttmp)) != NULL) {
+        if (!par_names_add(&names, ptmp + 1, pnend - ptmp - 1, etmp || itmp ? 0 : ctmp ? 1 : 2)) {
+            /* The parser found a duplicate or out of order parameter */
+            *fail = ptmp;
+            PROFILE_REWIND(s, match);
             *result = result_null;
             match = NULL;
             break;
         }
-#endif /* RFC_3966_CHECK_ORDER */
 
         char *lreg = max(result->pars_1,
                      max(result->pars_2,
                      max(result->pars_3,
-                         result->pars_4)));
+                     max(result->pars_4,
+                     max(result->pars_5,
+                     max(result->pars_6,
+                         result->pars_7))))));
         char *lpar = max(result->ext,
                      max(result->isdn,
                      max(result->context,
-                         lreg)));
+                     max(result->npdi,
+                     max(result->rn,
+                     max(result->cic,
+                         lreg))))));
         
         char **start = etmp ? &result->ext :
                        itmp ? &result->isdn :
-                       ctmp ? &result->context : NULL;
+                       ctmp ? &result->context :
+                       ntmp ? &result->npdi :
+                       rtmp ? &result->rn :
+                       ttmp ? &result->cic : NULL;
                       
         char **stop  = etmp ? &result->ext_stop :
                        itmp ? &result->isdn_stop :
-                       ctmp ? &result->context_stop : NULL;
+                       ctmp ? &result->context_stop :
+                       ntmp ? &result->npdi_stop :
+                       rtmp ? &result->rn_stop :
+                       ttmp ? &result->cic_stop : NULL;
                       
         if (start != NULL && *start == NULL) {
             /* This is the first occurance of a special parameter */
@@ -452,7 +672,8 @@ static const char *parse_par_star(const char **s, Pars *result) {
         } else if (start != NULL) {
             /* This is a special parameter but has been seen before
                Thus this parameter list is invalid */
-            *s = match;
+            *fail = ptmp;
+            PROFILE_REWIND(s, match);
             *result = result_null;
             match = NULL;
             break;
@@ -462,75 +683,571 @@ static const char *parse_par_star(const char **s, Pars *result) {
             stop = lreg == result->pars_1 ? &result->pars_1_stop :
                    lreg == result->pars_2 ? &result->pars_2_stop :
                    lreg == result->pars_3 ? &result->pars_3_stop :
-                                            &result->pars_4_stop;
+                   lreg == result->pars_4 ? &result->pars_4_stop :
+                   lreg == result->pars_5 ? &result->pars_5_stop :
+                   lreg == result->pars_6 ? &result->pars_6_stop :
+                                            &result->pars_7_stop;
             *stop = (char*)*s;
         } else {
             /* This is a regular parameter but the previous was special
-               so it must be put into the next unused pars member */
+               so it must be put into the next unused pars member.  Each
+               of the six special parameters can only appear once, so
+               they split the regular ones into at most seven runs. */
             start = lreg == NULL           ? &result->pars_1 :
                     lreg == result->pars_1 ? &result->pars_2 :
                     lreg == result->pars_2 ? &result->pars_3 :
-                    lreg == result->pars_3 ? &result->pars_4 : NULL;
+                    lreg == result->pars_3 ? &result->pars_4 :
+                    lreg == result->pars_4 ? &result->pars_5 :
+                    lreg == result->pars_5 ? &result->pars_6 :
+                                             &result->pars_7;
             stop  = lreg == NULL           ? &result->pars_1_stop :
                     lreg == result->pars_1 ? &result->pars_2_stop :
                     lreg == result->pars_2 ? &result->pars_3_stop :
-                    lreg == result->pars_3 ? &result->pars_4_stop : NULL;
+                    lreg == result->pars_3 ? &result->pars_4_stop :
+                    lreg == result->pars_4 ? &result->pars_5_stop :
+                    lreg == result->pars_5 ? &result->pars_6_stop :
+                                             &result->pars_7_stop;
             *start = (char*)ptmp;
             *stop = (char*)*s;
         }
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* local-number = local-number-digits *par context *par */
-static const char *parse_local_number(const char **s, Tel *t) {
+static const char *parse_local_number(const char **s, Tel *t, const char **fail) {
+    PROFILE_RULE();
     const char *match = parse_local_number_digits(s);
     /* Check for valid par list and context, which must be present */
     if (match != NULL) {
         t->local_number = (char*)match;
         t->number_stop = (char*)*s;
         /* Check for valid par list and context, which must be present */
-        if (parse_par_star(s, &t->pars) == NULL || t->pars.context == NULL) {
-            *s = match;
+        const char *pars = parse_par_star(s, &t->pars, fail);
+        if (pars == NULL || t->pars.context == NULL) {
+            if (pars != NULL) {
+                /* The context was expected after the parameters */
+                *fail = *s;
+            }
+            PROFILE_REWIND(s, match);
             match = NULL;
         }
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* global-number = global-number-digits *par */
-static const char *parse_global_number(const char **s, Tel *t) {
+static const char *parse_global_number(const char **s, Tel *t, const char **fail) {
+    PROFILE_RULE();
     const char *match = parse_global_number_digits(s);
     if (match != NULL) {
         t->global_number = (char*)match;
         t->number_stop = (char*)*s;
         /* Check for valid par list but not context, which shouldn't be present */
-        if (parse_par_star(s, &t->pars) == NULL || t->pars.context != NULL) {
-            *s = match;
+        if (parse_par_star(s, &t->pars, fail) == NULL || t->pars.context != NULL) {
+            if (t->pars.context != NULL) {
+                *fail = t->pars.context;
+            }
+            PROFILE_REWIND(s, match);
             match = NULL;
         }
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
-/* telephone-subscriber global-number / local-number */
-static const char *parse_telephone_subscriber(const char **s, Tel *t) {
-    const char *match = parse_global_number(s, t);
+/* telephone-subscriber global-number / local-number
+ * Only one of them can get past its digits, so only that one sets fail. */
+static const char *parse_telephone_subscriber(const char **s, Tel *t, const char **fail) {
+    PROFILE_RULE();
+    const char *match = parse_global_number(s, t, fail);
     if (match == NULL) {
-        match = parse_local_number(s, t);
+        match = parse_local_number(s, t, fail);
+    }
+    return PROFILE_EXIT(match);
+}
+
+/* telephone-uri = "tel:" telephone-subscriber
+ * The error is only looked at on the failure branch, so the success path
+ * is the same whether or not one is asked for. */
+static Tel parse_telephone_reporting(const char *uri, Tel_error *error) {
+    const char **s = &uri;
+    const char *start = uri;
+    const char *stop = NULL;
+    const int metered = metrics_enabled;
+    const unsigned long long began = metered ? metrics_now() : 0;
+    int reason = -1;
+    Tel result = { 0 };
+    if (parse_str(s, "tel:") == NULL) {
+        reason = METRICS_FAIL_SCHEME;
+        for (stop = start; stop - start < 4 && *stop == "tel:"[stop - start]; stop++);
+    } else if (parse_telephone_subscriber(s, &result, &stop) == NULL) {
+        /* The number is only filled in if its digits were valid,
+           and then stop is where its parameters went wrong */
+        if (result.global_number != NULL || result.local_number != NULL) {
+            reason = METRICS_FAIL_PARAMETERS;
+        } else {
+            reason = METRICS_FAIL_NUMBER;
+            stop = *s;
+        }
+    } else if (**s != '\0') {
+        reason = METRICS_FAIL_END;
+        stop = *s;
+    }
+    if (reason >= 0) {
+        static const Tel result_null = { 0 };
+        if (error != NULL) {
+            error->offset = stop - start;
+            error->component = metrics_reason_name(reason);
+        }
+        result = result_null;
+    }
+    if (metered) {
+        metrics_record(METRICS_TEL, (stop != NULL ? stop : *s) - start, reason, began);
+    }
+    return result;
+}
+
+Tel CHARSET_ENTRY(parse_telephone)(const char *uri) {
+    PROFILE_RULE();
+    Tel result = parse_telephone_reporting(uri, NULL);
+    PROFILE_COUNT(result.global_number != NULL || result.local_number != NULL);
+    return result;
+}
+
+/* The rest of the API is only in the ASCII build */
+#if URI_CHARSET == URI_CHARSET_ASCII
+Tel parse_telephone_utf8(const char *);
+Tel parse_telephone_custom(const char *);
+extern __thread const charset *charset_current;
+
+/* As for parse_URI_charset */
+Tel parse_telephone_charset(const charset *cs, const char *uri) {
+    if (cs == NULL || cs == &charset_ascii) {
+        return parse_telephone(uri);
+    } else if (cs == &charset_utf8) {
+        return parse_telephone_utf8(uri);
+    } else {
+#ifdef URI_NO_CUSTOM_CHARSET
+        static const Tel result_null = { 0 };
+        return result_null;
+#else
+        const charset *saved = charset_current;
+        Tel result;
+        charset_current = cs;
+        result = parse_telephone_custom(uri);
+        charset_current = saved;
+        return result;
+#endif
+    }
+}
+
+Tel parse_telephone_error(const char *uri, Tel_error *error) {
+    PROFILE_RULE();
+    Tel result = parse_telephone_reporting(uri, error);
+    PROFILE_COUNT(result.global_number != NULL || result.local_number != NULL);
+    return result;
+}
+
+/* Validation checks the bytes between p and end directly, taking the
+ * same path through the grammar as the parsers above, so nothing has to
+ * be copied to be NULL terminated.  Each scan_* returns where its rule
+ * stops matching, or NULL if it doesn't match at all. */
+
+static bool is_alnum(char c) {
+    return c >= 'a' && c <= 'z' || c >= 'A' && c <= 'Z' || c >= '0' && c <= '9';
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static bool is_visual_separator(char c) {
+    return c == '-' || c == '.' || c == '(' || c == ')';
+}
+
+/* Whether the bytes at p start with the NULL terminated lit */
+static bool has_prefix(const char *p, const char *end, const char *lit) {
+    size_t len = strlen(lit);
+    return (size_t)(end - p) >= len && memcmp(p, lit, len) == 0;
+}
+
+/* chars followed by pct-encoded, where at least min are needed */
+static const char *scan_chars(const char *p, const char *end, const char *chars, size_t min) {
+    const char *start = p;
+    while (p < end) {
+        if (is_alnum(*p) || strchr(chars, *p) != NULL && *p != '\0') {
+            p++;
+        } else if (*p == '%' && end - p >= 3 && is_hexdig(p[1]) && is_hexdig(p[2])) {
+            p += 3;
+        } else {
+            break;
+        }
+    }
+    return (size_t)(p - start) >= min ? p : NULL;
+}
+
+/* global-number-digits = "+" *phonedigit DIGIT *phonedigit */
+static const char *scan_global_number_digits(const char *p, const char *end) {
+    if (p == end || *p++ != '+') {
+        return NULL;
+    }
+    for (; p < end && is_visual_separator(*p); p++);
+    if (p == end || !is_digit(*p)) {
+        return NULL;
+    }
+    for (; p < end && (is_digit(*p) || is_visual_separator(*p)); p++);
+    return p;
+}
+
+/* local-number-digits = *phonedigit-hex (HEXDIG / "*" / "#") *phonedigit-hex */
+static const char *scan_local_number_digits(const char *p, const char *end) {
+    for (; p < end && is_visual_separator(*p); p++);
+    if (p == end || !is_hexdig(*p) && *p != '*' && *p != '#') {
+        return NULL;
+    }
+    for (; p < end && (is_hexdig(*p) || *p == '*' || *p == '#' || is_visual_separator(*p)); p++);
+    return p;
+}
+
+/* 1*phonedigit, after the visual separators parse_n_star takes first */
+static const char *scan_phonedigits(const char *p, const char *end) {
+    const char *start = p;
+    for (; p < end && (is_digit(*p) || is_visual_separator(*p)); p++);
+    return p > start ? p : NULL;
+}
+
+/* global-rn / local-rn, as parse_hex_digits */
+static const char *scan_hex_digits(const char *p, const char *end) {
+    const char *start = p;
+    if (p < end && *p == '+') {
+        if (++p == end || !is_digit(*p)) {
+            return NULL;
+        }
+    }
+    for (; p < end && (is_hexdig(*p) || is_visual_separator(*p)); p++);
+    return p > start ? p : NULL;
+}
+
+/* domainlabel = alphanum / alphanum *( alphanum / "-" ) alphanum
+ * As parse_label_char, a run ending in "-" leaves just the first alphanum */
+static const char *scan_domainlabel(const char *p, const char *end) {
+    const char *run = NULL;
+    if (p == end || !is_alnum(*p)) {
+        return NULL;
+    }
+    for (run = ++p; run < end && (is_alnum(*run) || *run == '-'); run++);
+    return run > p && is_alnum(run[-1]) ? run : p;
+}
+
+/* domainname = *( domainlabel "." ) toplabel [ "." ], as parse_domainname */
+static const char *scan_domainname(const char *p, const char *end) {
+    const char *stop = NULL;
+    const char *label = p;
+    while ((p = scan_domainlabel(label, end)) != NULL) {
+        bool dot = p < end && *p == '.';
+        p += dot;
+        if (!is_digit(*label)) {
+            stop = p;
+        }
+        if (!dot) {
+            break;
+        }
+        label = p;
+    }
+    return stop;
+}
+
+/* descriptor = domainname / global-number-digits */
+static const char *scan_descriptor(const char *p, const char *end) {
+    const char *stop = scan_domainname(p, end);
+    return stop != NULL ? stop : scan_global_number_digits(p, end);
+}
+
+/* One par after its ";", as parse_par, setting *pnend to the end of its
+ * name and *rank as par_names_add takes it */
+static const char *scan_par(const char *p, const char *end, const char **pnend, int *rank) {
+    const char *stop = NULL;
+    *rank = 0;
+    if (has_prefix(p, end, "ext=") && (stop = scan_phonedigits(p + 4, end)) != NULL) {
+        *pnend = p + 3;
+        return stop;
+    }
+    if (has_prefix(p, end, "isub=") && (stop = scan_chars(p + 5, end, "/?:@&=+$,-_.!~*'()", 1)) != NULL) {
+        *pnend = p + 4;
+        return stop;
+    }
+    *rank = 1;
+    if (has_prefix(p, end, "phone-context=") && (stop = scan_descriptor(p + 14, end)) != NULL) {
+        *pnend = p + 13;
+        return stop;
+    }
+    *rank = 2;
+    if (has_prefix(p, end, "npdi") &&
+        (p + 4 == end || p[4] != '=' && p[4] != '-' && !is_alnum(p[4]))) {
+        *pnend = p + 4;
+        return p + 4;
+    }
+    if (has_prefix(p, end, "rn=") && (stop = scan_hex_digits(p + 3, end)) != NULL) {
+        *pnend = p + 2;
+        return stop;
+    }
+    if (has_prefix(p, end, "cic=") && (stop = scan_hex_digits(p + 4, end)) != NULL) {
+        *pnend = p + 3;
+        return stop;
+    }
+    /* parameter = ";" pname ["=" pvalue ] */
+    for (stop = p; stop < end && (is_alnum(*stop) || *stop == '-'); stop++);
+    if (stop == p) {
+        return NULL;
+    }
+    *pnend = stop;
+    if (stop < end && *stop == '=') {
+        const char *value = scan_chars(stop + 1, end, "[]/:&+$-_.!~*'()", 1);
+        stop = value != NULL ? value : stop;
+    }
+    return stop;
+}
+
+/* Checks in place, as parse_telephone would: the number, then each
+ * parameter, which has to run up to the next ";" since the parser
+ * never backtracks into one. */
+int is_valid_telephone(const char *uri, size_t len) {
+    const char *end = uri + len;
+    const char *p = uri + 4;
+    const char *number = NULL;
+    bool global = false;
+    bool context = false;
+    par_names names;
+    if (len < 4 || memcmp(uri, "tel:", 4) != 0 || find_non_uri_char(p, end) != end) {
+        return 0;
+    }
+    global = (number = scan_global_number_digits(p, end)) != NULL;
+    if (!global && (number = scan_local_number_digits(p, end)) == NULL) {
+        return 0;
+    }
+    p = number;
+    if (p == end) {
+        return global;
     }
-    return match;
+    par_names_init(&names);
+    while (p < end) {
+        const char *pnend = NULL;
+        int rank = 0;
+        const char *stop = *p == ';' ? scan_par(p + 1, end, &pnend, &rank) : NULL;
+        if (stop == NULL || stop < end && *stop != ';' ||
+            !par_names_add(&names, p + 1, pnend - p - 1, rank)) {
+            return 0;
+        }
+        context = context || rank == 1;
+        p = stop;
+    }
+    return global != context;
 }
 
-/* telephone-uri = "tel:" telephone-subscriber */
-Tel parse_telephone(const char *uri) {
+/* No parameter can contain ";", so they're found again by looking for
+ * it after the number, which is short enough to still be in cache. */
+Tel parse_telephone_events(const char *uri, const Tel_handler *handler, void *ctx) {
+    PROFILE_RULE();
     const char **s = &uri;
+    const char *fail = NULL;
     Tel result = { 0 };
-    if (parse_str(s, "tel:") != NULL) {
-        if (parse_telephone_subscriber(s, &result) == NULL || **s != '\0') {
-            static const Tel result_null = { 0 };
-            result = result_null;
+    if (parse_str(s, "tel:") == NULL ||
+        parse_telephone_subscriber(s, &result, &fail) == NULL ||
+        **s != '\0') {
+        static const Tel result_null = { 0 };
+        result = result_null;
+    } else {
+        const char *number = result.global_number != NULL ? result.global_number : result.local_number;
+        const char *p = result.number_stop;
+        if (handler->number != NULL) {
+            handler->number(ctx, number, result.number_stop - number);
+        }
+        while (handler->parameter != NULL && p < *s) {
+            const char *name = p + 1;
+            const char *semicolon = strchr(name, ';');
+            const char *stop = semicolon != NULL ? semicolon : *s;
+            const char *equal = memchr(name, '=', stop - name);
+            handler->parameter(ctx, name, (equal != NULL ? equal : stop) - name,
+                               equal != NULL ? equal + 1 : NULL, equal != NULL ? stop - (equal + 1) : 0);
+            p = stop;
         }
     }
+    PROFILE_COUNT(result.global_number != NULL || result.local_number != NULL);
     return result;
 }
+
+/* Comparison per RFC 3966 section 4.  Nothing here is allocated; the
+ * fields are compared character by character straight from the input,
+ * lowercased and, where they are digits, without visual separators. */
+
+#define PARS_SPANS 13
+
+#define FNV_OFFSET ((size_t)2166136261UL)
+#define FNV_PRIME  ((size_t)16777619UL)
+
+/* Next character of a field to compare, or -1 at the end of the field */
+static int next_cmp_char(const char **p, const char *stop, int digits) {
+    for (; *p < stop; (*p)++) {
+        char c = **p;
+        if (digits && (c == '-' || c == '.' || c == '(' || c == ')')) {
+            continue;
+        }
+        (*p)++;
+        return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : (unsigned char)c;
+    }
+    return -1;
+}
+
+static int field_equal(const char *a, const char *a_stop, const char *b, const char *b_stop, int digits) {
+    int ca = 0;
+    int cb = 0;
+    do {
+        ca = next_cmp_char(&a, a_stop, digits);
+        cb = next_cmp_char(&b, b_stop, digits);
+    } while (ca == cb && ca != -1);
+    return ca == cb;
+}
+
+static size_t field_hash(size_t h, const char *p, const char *stop, int digits) {
+    int c = 0;
+    while ((c = next_cmp_char(&p, stop, digits)) != -1) {
+        h = (h ^ (size_t)c) * FNV_PRIME;
+    }
+    return h;
+}
+
+static int name_is(const char *name, const char *stop, const char *lit) {
+    return field_equal(name, stop, lit, lit + strlen(lit), 0);
+}
+
+/* The Pars members each hold a run of ";pname[=pvalue]" parameters */
+static const char *par_span(const Pars *pars, int i, const char **stop) {
+    switch (i) {
+    case 0: *stop = pars->ext_stop;     return pars->ext;
+    case 1: *stop = pars->isdn_stop;    return pars->isdn;
+    case 2: *stop = pars->context_stop; return pars->context;
+    case 3: *stop = pars->npdi_stop;    return pars->npdi;
+    case 4: *stop = pars->rn_stop;      return pars->rn;
+    case 5: *stop = pars->cic_stop;     return pars->cic;
+    case 6: *stop = pars->pars_1_stop;  return pars->pars_1;
+    case 7: *stop = pars->pars_2_stop;  return pars->pars_2;
+    case 8: *stop = pars->pars_3_stop;  return pars->pars_3;
+    case 9: *stop = pars->pars_4_stop;  return pars->pars_4;
+    case 10: *stop = pars->pars_5_stop; return pars->pars_5;
+    case 11: *stop = pars->pars_6_stop; return pars->pars_6;
+    case 12: *stop = pars->pars_7_stop; return pars->pars_7;
+    }
+    *stop = NULL;
+    return NULL;
+}
+
+/* Step to the next parameter, whose pname runs from name to value and
+ * whose "=" pvalue, if any, runs from value to stop.  Start with *span
+ * at 0 and *p at NULL.  Returns 0 when there are no more. */
+static int next_par(const Pars *pars, int *span, const char **p, const char **name, const char **value, const char **stop) {
+    const char *span_stop = NULL;
+    for (; *span < PARS_SPANS; (*span)++, *p = NULL) {
+        const char *start = par_span(pars, *span, &span_stop);
+        if (*p == NULL) {
+            *p = start;
+        }
+        if (*p != NULL && *p < span_stop) {
+            break;
+        }
+    }
+    if (*span == PARS_SPANS) {
+        return 0;
+    }
+    /* Skip the ; */
+    *name = *p + 1;
+    for (*stop = *name; *stop < span_stop && **stop != ';'; (*stop)++);
+    for (*value = *name; *value < *stop && **value != '='; (*value)++);
+    *p = *stop;
+    return 1;
+}
+
+/* Whether a pvalue is compared as digits without visual separators */
+static int par_value_is_digits(const char *name, const char *value, const char *stop) {
+    return name_is(name, value, "ext") ||
+           name_is(name, value, "rn") ||
+           name_is(name, value, "cic") ||
+           (name_is(name, value, "phone-context") && value + 1 < stop && value[1] == '+');
+}
+
+static int par_equal(const char *a_name, const char *a_value, const char *a_stop,
+                     const char *b_name, const char *b_value, const char *b_stop) {
+    return field_equal(a_name, a_value, b_name, b_value, 0) &&
+           field_equal(a_value, a_stop, b_value, b_stop,
+                       par_value_is_digits(a_name, a_value, a_stop));
+}
+
+static size_t par_hash(const char *name, const char *value, const char *stop) {
+    size_t h = field_hash(FNV_OFFSET, name, value, 0);
+    h = field_hash(h, value, stop, par_value_is_digits(name, value, stop));
+    /* Parameters are summed, so spread each one over the whole hash */
+    h ^= h >> 15;
+    h *= FNV_PRIME;
+    h ^= h >> 13;
+    return h;
+}
+
+int tel_equal(const Tel *a, const Tel *b) {
+    const char *a_number = a->global_number ? a->global_number : a->local_number;
+    const char *b_number = b->global_number ? b->global_number : b->local_number;
+    int a_span = 0;
+    const char *a_p = NULL;
+    const char *a_name = NULL;
+    const char *a_value = NULL;
+    const char *a_stop = NULL;
+    size_t a_count = 0;
+    size_t b_count = 0;
+    if (a_number == NULL || b_number == NULL ||
+        (a->global_number == NULL) != (b->global_number == NULL) ||
+        !field_equal(a_number, a->number_stop, b_number, b->number_stop, 1)) {
+        return 0;
+    }
+    while (next_par(&a->pars, &a_span, &a_p, &a_name, &a_value, &a_stop)) {
+        int b_span = 0;
+        const char *b_p = NULL;
+        const char *b_name = NULL;
+        const char *b_value = NULL;
+        const char *b_stop = NULL;
+        int found = 0;
+        a_count++;
+        while (!found && next_par(&b->pars, &b_span, &b_p, &b_name, &b_value, &b_stop)) {
+            found = par_equal(a_name, a_value, a_stop, b_name, b_value, b_stop);
+        }
+        if (!found) {
+            return 0;
+        }
+    }
+    /* Every parameter of a is in b, so they are equal if b has no more */
+    {
+        int b_span = 0;
+        const char *b_p = NULL;
+        while (next_par(&b->pars, &b_span, &b_p, &a_name, &a_value, &a_stop)) {
+            b_count++;
+        }
+    }
+    return a_count == b_count;
+}
+
+size_t tel_hash(const Tel *t) {
+    const char *number = t->global_number ? t->global_number : t->local_number;
+    size_t h = FNV_OFFSET;
+    int span = 0;
+    const char *p = NULL;
+    const char *name = NULL;
+    const char *value = NULL;
+    const char *stop = NULL;
+    if (number == NULL) {
+        return 0;
+    }
+    h = field_hash(h, number, t->number_stop, 1);
+    while (next_par(&t->pars, &span, &p, &name, &value, &stop)) {
+        /* Addition doesn't care about the order of the parameters */
+        h += par_hash(name, value, stop);
+    }
+    return h;
+}
+#endif /* URI_CHARSET_ASCII */
@@ -31,13 +31,15 @@
  */
 
 #include "rfc_3986.h"
+#include "charset.h"
+#include "metrics.h"
 #include "hof.h"
 #include "chars.h"
 
-#include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
 
+#if URI_CHARSET == URI_CHARSET_ASCII
 MAKE_LEN(URI, scheme,   data->colon_s                                          )
 MAKE_LEN(URI, userinfo, data->atsymbol                                         )
 MAKE_LEN(URI, host,     OR(colon_p,   OR(path, OR(question, OR(pound, data->end)))))
@@ -54,6 +56,72 @@ MAKE_GETTER(URI, path)
 MAKE_GETTER(URI, query)
 MAKE_GETTER(URI, fragment)
 
+/* Each field ends where the next one present starts, less its
+ * delimiter, so the walk goes back from the end */
+#define VIEW(which, start, stop) \
+    views.field[which].ptr = (start); \
+    views.field[which].len = (start) ? (size_t)((stop) - (start)) : 0
+URI_views get_URI_views(const URI *uri) {
+    URI_views views;
+    const char *end = uri->end;
+    VIEW(URI_FIELD_FRAGMENT, uri->fragment, end);
+    end = uri->pound ? uri->pound : end;
+    VIEW(URI_FIELD_QUERY, uri->query, end);
+    end = uri->question ? uri->question : end;
+    VIEW(URI_FIELD_PATH, uri->path, end);
+    end = uri->path ? uri->path : end;
+    VIEW(URI_FIELD_PORT, uri->port, end);
+    end = uri->colon_p ? uri->colon_p : end;
+    VIEW(URI_FIELD_HOST, uri->host, end);
+    VIEW(URI_FIELD_USERINFO, uri->userinfo, uri->atsymbol);
+    VIEW(URI_FIELD_SCHEME, uri->scheme, uri->colon_s);
+    return views;
+}
+#undef VIEW
+
+/* The fields other than the path are copied as one span, from the first
+ * wanted to the end of the last, with the NULL terminating bytes written
+ * over the delimiter after each.  The path needs its own copy, since a
+ * host or port ends at its first character. */
+char *get_URI_fields(const URI *uri, unsigned int fields, char *buf, size_t *len, size_t offsets[URI_FIELDS]) {
+    URI_views views = get_URI_views(uri);
+    const char *start = NULL;
+    const char *stop = NULL;
+    size_t span = 0;
+    size_t needed = 0;
+    int path = (fields & 1u << URI_FIELD_PATH) && views.field[URI_FIELD_PATH].ptr != NULL;
+    int i = 0;
+    for (i = 0; i < URI_FIELDS; i++) {
+        if (i != URI_FIELD_PATH && (fields & 1u << i) && views.field[i].ptr != NULL) {
+            start = start ? start : views.field[i].ptr;
+            stop = views.field[i].ptr + views.field[i].len;
+        }
+    }
+    span = start ? (size_t)(stop - start) + 1 : 0;
+    needed = span + (path ? views.field[URI_FIELD_PATH].len + 1 : 0);
+    if (needed > *len) {
+        *len = needed;
+        return NULL;
+    }
+    if (start != NULL) {
+        memcpy(buf, start, span - 1);
+    }
+    for (i = 0; i < URI_FIELDS; i++) {
+        offsets[i] = URI_FIELD_ABSENT;
+        if (i != URI_FIELD_PATH && (fields & 1u << i) && views.field[i].ptr != NULL) {
+            offsets[i] = views.field[i].ptr - start;
+            buf[offsets[i] + views.field[i].len] = '\0';
+        }
+    }
+    if (path) {
+        offsets[URI_FIELD_PATH] = span;
+        memcpy(&buf[span], views.field[URI_FIELD_PATH].ptr, views.field[URI_FIELD_PATH].len);
+        buf[needed - 1] = '\0';
+    }
+    return buf;
+}
+#endif /* URI_CHARSET_ASCII */
+
 /* For the parsers other than parse_URI, the protocol is as
  * follows: If the parser does not match, return NULL and don't
  * modify the input string *s. If the parser matches, return a
@@ -63,61 +131,82 @@ MAKE_GETTER(URI, fragment)
 
 /* pct-encoded = "%" HEXDIG HEXDIG */
 static const char *parse_pct_encoded(const char **s) {
-    return parse_cat(s, 3, parse_percent, parse_hexdig, parse_hexdig);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_CAT(s, parse_percent, parse_hexdig, parse_hexdig));
 }
 
 /* unreserved = ALPHA / DIGIT / "-" / "." / "_" / "~" */
 static const char *parse_unreserved(const char **s) {
-    return parse_opt(s, 6, parse_alpha, parse_digit, parse_dash,
-                           parse_dot, parse_underscore, parse_tilde);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_alpha, parse_digit, parse_dash,
+                                              parse_dot, parse_underscore, parse_tilde));
 }
 
+/* iunreserved = ALPHA / DIGIT / "-" / "." / "_" / "~" / ucschar
+ * RFC 3987 uses this in place of unreserved everywhere but IPvFuture */
+#if URI_CHARSET == URI_CHARSET_IRI
+static const char *parse_iunreserved(const char **s) {
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_unreserved, parse_ucschar));
+}
+#else
+#define parse_iunreserved parse_unreserved
+#endif
+
 /* gen-delims = ":" / "/" / "?" / "#" / "[" / "]" / "@" */
 static const char *parse_gen_delims(const char **s) {
-    return parse_opt(s, 7, parse_colon, parse_fwd_slash, parse_question,
-                           parse_pound, parse_lbracket, parse_rbracket, parse_atsymbol);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_colon, parse_fwd_slash, parse_question,
+                                              parse_pound, parse_lbracket, parse_rbracket, parse_atsymbol));
 }
 
 /*    sub-delims    = "!" / "$" / "&" / "'" / "(" / ")"
  *                  / "*" / "+" / "," / ";" / "=" */
 static const char *parse_sub_delims(const char **s) {
-    return parse_opt(s, 11, parse_exclamation, parse_dollar, parse_ampersand,
-                            parse_singlequote, parse_lparens, parse_rparens, parse_star,
-                            parse_plus, parse_comma, parse_semicolon, parse_equal);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_exclamation, parse_dollar, parse_ampersand,
+                                              parse_singlequote, parse_lparens, parse_rparens, parse_star,
+                                              parse_plus, parse_comma, parse_semicolon, parse_equal));
 }
 
 /* reserved = gen-delims / sub-delims */
 static const char *parse_reserved(const char **s) {
-    return parse_opt(s, 2, parse_gen_delims, parse_sub_delims);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_gen_delims, parse_sub_delims));
 }
 
 /* pchar = unreserved / pct-encoded / sub-delims / ":" / "@" */
 static const char *parse_pchar(const char **s) {
-    return parse_opt(s, 5, parse_unreserved, parse_pct_encoded,
-                        parse_sub_delims, parse_colon, parse_atsymbol);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_iunreserved, parse_pct_encoded,
+                                              parse_sub_delims, parse_colon, parse_atsymbol));
 }
 
 /* scheme = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." ) */
 static const char *parse_scheme_char(const char **s) {
-    return parse_opt(s, 5, parse_alpha, parse_digit,
-                           parse_plus, parse_dash, parse_dot);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_alpha, parse_digit,
+                                              parse_plus, parse_dash, parse_dot));
 }
 static const char *parse_scheme(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_alpha(s);
     if (match != NULL) {
         parse_n_star(s, 0, parse_scheme_char);
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* userinfo  = *( unreserved / pct-encoded / sub-delims / ":" ) */
 static const char *parse_userinfo_char(const char **s) {
-    return parse_opt(s, 4, parse_unreserved, parse_pct_encoded,
-                           /* colon is handled in parse_userinfo
-                              parse_colon, */
-                           parse_sub_delims);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_iunreserved, parse_pct_encoded,
+                                              /* colon is handled in parse_userinfo
+                                                 parse_colon, */
+                                              parse_sub_delims));
 }
 static const char *parse_userinfo(const char **s, const char **maybe_colon) {
+    PROFILE_RULE();
     const char *match = parse_n_star(s, 0, parse_userinfo_char);
     /* The complexity of this is necessary to identify the first colon,
        which is used to avoid reparsing if this is a host, not a userinfo */
@@ -126,32 +215,36 @@ static const char *parse_userinfo(const char **s, const char **maybe_colon) {
             parse_n_star(s, 0, parse_userinfo_char);
         } while (parse_colon(s) != NULL);
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* reg-name = *( unreserved / pct-encoded / sub-delims ) */
 static const char *parse_reg_name_char(const char **s) {
-    return parse_opt(s, 3, parse_unreserved, parse_pct_encoded,
-                           parse_sub_delims);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_iunreserved, parse_pct_encoded,
+                                              parse_sub_delims));
 }
 static const char *parse_reg_name(const char **s) {
-    return parse_n_star(s, 0, parse_reg_name_char);
+    PROFILE_RULE();
+    return PROFILE_EXIT(parse_n_star(s, 0, parse_reg_name_char));
 }
 
 /* IPvFuture = "v" 1*HEXDIG "." 1*( unreserved / sub-delims / ":" ) */
 static const char *parse_unreserved_or_sub_delims_or_colon(const char **s) {
-    return parse_opt(s, 3, parse_unreserved, parse_sub_delims, parse_colon);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_unreserved, parse_sub_delims, parse_colon));
 }
 static const char *parse_IPvFuture(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_char(s, 'v');
     if (match == NULL ||
         parse_n_star(s, 1, parse_hexdig) == NULL ||
         parse_dot(s) == NULL ||
         parse_n_star(s, 1, parse_unreserved_or_sub_delims_or_colon) == NULL) {
-        *s = match;
+        PROFILE_REWIND(s, match);
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* dec-octet = DIGIT                 ; 0-9
@@ -160,6 +253,7 @@ static const char *parse_IPvFuture(const char **s) {
  *           / "2" %x30-34 DIGIT     ; 200-249
  *           / "25" %x30-35          ; 250-255 */
 static const char *parse_dec_octet(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_digit(s);
     if (match != NULL) {
         if (*match != '0') { /* else case 1 */
@@ -170,65 +264,74 @@ static const char *parse_dec_octet(const char **s) {
                     if (!(*match == '1' || /* else case 3 */
                           *match == '2' && *d2 <= '4' || /* else case 4 */
                           *match == '2' && *d2 == '5' && *d3 <= '5')) /* else case 5 */
-                    { *s = d3; } /* oops, still case 2, rewind */
+                    { PROFILE_REWIND(s, d3); } /* oops, still case 2, rewind */
                 }
             }
         }
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* IPv4address = dec-octet "." dec-octet "." dec-octet "." dec-octet */
 static const char *parse_IPv4address(const char **s) {
-    return parse_cat(s, 7, parse_dec_octet, parse_dot, parse_dec_octet, parse_dot,
-                           parse_dec_octet, parse_dot, parse_dec_octet);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_CAT(s, parse_dec_octet, parse_dot, parse_dec_octet, parse_dot,
+                                     parse_dec_octet, parse_dot, parse_dec_octet));
 }
 
 /* h16 = 1*4HEXDIG */
 static const char *parse_h16(const char **s) {
-    return parse_n_to_m(s, 1, 4, parse_hexdig);
+    PROFILE_RULE();
+    return PROFILE_EXIT(parse_n_to_m(s, 1, 4, parse_hexdig));
 }
 
 static const char *parse_h16_colon(const char **s) {
-    const char *match = parse_cat(s, 2, parse_h16, parse_colon);
-    return match;
+    PROFILE_RULE();
+    const char *match = PARSE_CAT(s, parse_h16, parse_colon);
+    return PROFILE_EXIT(match);
 }
 
 static const char *parse_h16_colon_h16(const char **s) {
-    return parse_cat(s, 3, parse_h16, parse_colon, parse_h16);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_CAT(s, parse_h16, parse_colon, parse_h16));
 }
 
 /* ls32 = ( h16 ":" h16 ) / IPv4address */
 static const char *parse_ls32(const char **s) {
-    return parse_opt(s, 2, parse_h16_colon_h16, parse_IPv4address);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT(s, parse_h16_colon_h16, parse_IPv4address));
 }
 
 /* IPv6address =                            6( h16 ":" ) ls32 */
 static const char *parse_IPv6address_case_1(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_n(s, 6, parse_h16_colon);
     if (match != NULL && parse_ls32(s) == NULL)  {
-        *s = match;
+        PROFILE_REWIND(s, match);
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 /*             /                       "::" 5( h16 ":" ) ls32 */
 static const char *parse_IPv6address_case_2(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_colon(s);
     if (match != NULL &&
         (parse_colon(s) == NULL ||
          parse_n(s, 5, parse_h16_colon) == NULL ||
          parse_ls32(s) == NULL))  {
-        *s = match;
+        PROFILE_REWIND(s, match);
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 /*             / [               h16 ] "::" 4( h16 ":" ) ls32 */
 static const char *parse_colon_h16(const char **s) {
-    return parse_cat(s, 2, parse_colon, parse_h16);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_CAT(s, parse_colon, parse_h16));
 }
 static const char *parse_IPv6address_segment(const char **s, int m) {
+    PROFILE_RULE();
     const char *match = parse_h16(s);
     if (match != NULL) {
         parse_n_to_m(s, 0, m, parse_colon_h16);
@@ -236,174 +339,217 @@ static const char *parse_IPv6address_segment(const char **s, int m) {
     const char *colon = parse_colon(s);
     if (colon == NULL || parse_colon(s) == NULL)
     {
-        *s = match;
+        PROFILE_REWIND(s, match);
         match = NULL;
     } else if (match == NULL) {
         match = colon;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 static const char *parse_IPv6address_case_3(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_IPv6address_segment(s, 0);
     if (match != NULL &&
         (parse_n(s, 4, parse_h16_colon) == NULL ||
          parse_ls32(s) == NULL)) {
-        *s = match;
+        PROFILE_REWIND(s, match);
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 /*             / [ *1( h16 ":" ) h16 ] "::" 3( h16 ":" ) ls32 */
 static const char *parse_IPv6address_case_4(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_IPv6address_segment(s, 1);
     if (match != NULL &&
         (parse_n(s, 3, parse_h16_colon) == NULL ||
          parse_ls32(s) == NULL))  {
-        *s = match;
+        PROFILE_REWIND(s, match);
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 /*             / [ *2( h16 ":" ) h16 ] "::" 2( h16 ":" ) ls32 */
 static const char *parse_IPv6address_case_5(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_IPv6address_segment(s, 2);
     if (match != NULL &&
         (parse_n(s, 2, parse_h16_colon) == NULL ||
          parse_ls32(s) == NULL))  {
-        *s = match;
+        PROFILE_REWIND(s, match);
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 /*             / [ *3( h16 ":" ) h16 ] "::"    h16 ":"   ls32 */
 static const char *parse_IPv6address_case_6(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_IPv6address_segment(s, 3);
     if (match != NULL &&
         (parse_n(s, 1, parse_h16_colon) == NULL ||
          parse_ls32(s) == NULL))  {
-        *s = match;
+        PROFILE_REWIND(s, match);
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 /*             / [ *4( h16 ":" ) h16 ] "::"              ls32 */
 static const char *parse_IPv6address_case_7(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_IPv6address_segment(s, 4);
     if (match != NULL && parse_ls32(s) == NULL)  {
-        *s = match;
+        PROFILE_REWIND(s, match);
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 /*             / [ *5( h16 ":" ) h16 ] "::"              h16 */
 static const char *parse_IPv6address_case_8(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_IPv6address_segment(s, 5);
     if (match != NULL && parse_h16(s) == NULL) {
-        *s = match;
+        PROFILE_REWIND(s, match);
         match = NULL;
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 /*             / [ *6( h16 ":" ) h16 ] "::" */
 static const char *parse_IPv6address_case_9(const char **s) {
-    return parse_IPv6address_segment(s, 6);
+    PROFILE_RULE();
+    return PROFILE_EXIT(parse_IPv6address_segment(s, 6));
 }
+/* Each case rewinds on failure, but none reads more than eight h16
+   groups, a "::" and an IPv4address, so no case reads more than 45
+   characters however long the input is.  In all, the nine cases
+   rescan a constant amount, keeping the parse linear. */
 static const char *parse_IPv6address(const char **s) {
-    return parse_opt(s, 9, parse_IPv6address_case_1, parse_IPv6address_case_2,
-                           parse_IPv6address_case_3, parse_IPv6address_case_4,
-                           parse_IPv6address_case_5, parse_IPv6address_case_6,
-                           parse_IPv6address_case_7, parse_IPv6address_case_8,
-                           parse_IPv6address_case_9);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT(s, parse_IPv6address_case_1, parse_IPv6address_case_2,
+                                     parse_IPv6address_case_3, parse_IPv6address_case_4,
+                                     parse_IPv6address_case_5, parse_IPv6address_case_6,
+                                     parse_IPv6address_case_7, parse_IPv6address_case_8,
+                                     parse_IPv6address_case_9));
 }
 
-/* IP-literal = "[" ( IPv6address / IPvFuture  ) "]" */
+/* IP-literal = "[" ( IPv6address / IPvFuture  ) "]"
+ * Either can be left out of the build, see rfc_3986.h */
 static const char *parse_IPv6address_or_IPvFuture(const char **s) {
-    return parse_opt(s, 2, parse_IPv6address, parse_IPvFuture);
+    PROFILE_RULE();
+#if defined(URI_NO_IPV6)
+    return PROFILE_EXIT(parse_IPvFuture(s));
+#elif defined(URI_NO_IPVFUTURE)
+    return PROFILE_EXIT(parse_IPv6address(s));
+#else
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_IPv6address, parse_IPvFuture));
+#endif
 }
 
 static const char *parse_IP_literal(const char **s) {
-    return parse_cat(s, 3, parse_lbracket, parse_IPv6address_or_IPvFuture, parse_rbracket);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_CAT(s, parse_lbracket, parse_IPv6address_or_IPvFuture, parse_rbracket));
 }
 
-/* host = IP-literal / IPv4address / reg-name */
+/* host = IP-literal / IPv4address / reg-name
+ * Without either kind of IP literal, there's no IP-literal at all */
 static const char *parse_host(const char **s) {
-    return parse_opt(s, 3, parse_IP_literal,
-                           /* IPv4address is contained by reg_name
-                              parse_IPv4address, */
-                           parse_reg_name);
+    PROFILE_RULE();
+#if defined(URI_NO_IPV6) && defined(URI_NO_IPVFUTURE)
+    return PROFILE_EXIT(parse_reg_name(s));
+#else
+    return PROFILE_EXIT(PARSE_OPT(s, parse_IP_literal,
+                                     /* IPv4address is contained by reg_name
+                                        parse_IPv4address, */
+                                     parse_reg_name));
+#endif
 }
 
 /* port = *DIGIT */
 static const char *parse_port(const char **s) {
-    return parse_n_star(s, 0, parse_digit);
+    PROFILE_RULE();
+    return PROFILE_EXIT(parse_n_star(s, 0, parse_digit));
 }
 
 /* segment = *pchar */
 static const char *parse_segment(const char **s) {
-    return parse_n_star(s, 0, parse_pchar);
+    PROFILE_RULE();
+    return PROFILE_EXIT(parse_n_star(s, 0, parse_pchar));
 }
 
 /* segment-nz = 1*pchar */
 static const char *parse_segment_nz(const char **s) {
-    return parse_n_star(s, 1, parse_pchar);
+    PROFILE_RULE();
+    return PROFILE_EXIT(parse_n_star(s, 1, parse_pchar));
 }
 
 /* path-abempty = *( "/" segment ) */
 static const char *parse_slash_segment(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_fwd_slash(s);
     if (match != NULL) {
         /* segment always succeeds */
         parse_segment(s);
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 static const char *parse_path_abempty(const char **s) {
-    return parse_n_star(s, 0, parse_slash_segment);
+    PROFILE_RULE();
+    return PROFILE_EXIT(parse_n_star(s, 0, parse_slash_segment));
 }
 
 /* path-rootless = segment-nz *( "/" segment ) */
 static const char *parse_path_rootless(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_segment_nz(s);
     if (match != NULL) {
         parse_path_abempty(s);
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* path-absolute = "/" [ segment-nz *( "/" segment ) ]
  * begins with "/" but not "//" */
 static const char *parse_path_absolute(const char **s) {
+    PROFILE_RULE();
     const char *match = parse_fwd_slash(s);
     if (match != NULL) {
         parse_path_rootless(s);
     }
-    return match;
+    return PROFILE_EXIT(match);
 }
 
 /* path-empty    = 0<pchar>                            ; zero characters */
 static const char *parse_path_empty(const char **s) {
-    return *s;
+    PROFILE_RULE();
+    return PROFILE_EXIT(*s);
 }
 
 /* hier-part = "//" authority path-abempty
  *           / path-absolute
  *           / path-rootless
  *           / path-empty
- * authority = [ userinfo "@" ] host [ ":" port ] */
-static const char *parse_hier_part(const char **s, const char **slash, const char **userinfo, const char **atsymbol, const char **host, const char **colon, const char **port) {
-    *slash     = NULL;
+ * authority = [ userinfo "@" ] host [ ":" port ]
+ * The authority and the path are parsed separately so that parsing can
+ * stop in between.  If there's no "//", this returns NULL and doesn't
+ * advance, otherwise it always succeeds, since every part of the
+ * authority can be empty. */
+static const char *parse_hier_authority(const char **s, const char **userinfo, const char **atsymbol, const char **host, const char **colon, const char **port) {
+    PROFILE_RULE();
+    const char *slash = NULL;
     *userinfo  = NULL;
     *atsymbol  = NULL;
     *host      = NULL;
     *colon     = NULL;
     *port      = NULL;
-    const char *path = NULL;
 
-    if (/* "//" authority path-abempty */
-        ((*slash = parse_fwd_slash(s)) != NULL) &&
+    if (/* "//" authority */
+        ((slash = parse_fwd_slash(s)) != NULL) &&
         ((parse_fwd_slash(s) != NULL) ||
          /* back up if the second '/' is missing */
-         ((*slash = NULL), (*s = (*s) - 1), false))) {
+         ((slash = NULL), PROFILE_REWIND(s, (*s) - 1), false))) {
+#ifdef URI_NO_USERINFO
+        /* without userinfo, an "@" is left to fail after the authority */
+        *host = parse_host(s);
+#else
         /* userinfo can be empty so will always succeed */
         *userinfo = parse_userinfo(s, colon);
         if ((*atsymbol = parse_atsymbol(s)) != NULL) {
@@ -414,17 +560,31 @@ static const char *parse_hier_part(const char **s, const char **slash, const cha
             *userinfo = NULL;
             if (*colon != NULL) {
                 /* it parsed a host and found a colon
-                   rewind since port syntax is different */
-                *s = *colon;
+                   rewind since port syntax is different.
+                   This only happens once, so the authority
+                   is scanned at most twice */
+                PROFILE_REWIND(s, *colon);
             } else if (*host == *s) {
                 /* it didn't parse anything because it
                    found a character like [ */
                 *host = parse_host(s);
             }
         }
+#endif /* URI_NO_USERINFO */
         if ((*colon = parse_colon(s)) != NULL) {
             *port = parse_port(s);
         }
+    }
+
+    return PROFILE_EXIT(slash);
+}
+
+/* The path-abempty after an authority, or else one of the others */
+static const char *parse_hier_path(const char **s, bool authority) {
+    PROFILE_RULE();
+    const char *path = NULL;
+
+    if (authority) {
         /* path can be empty so will always succeed */
         path = parse_path_abempty(s);
     } else if (((path = parse_path_absolute(s)) == NULL) &&
@@ -433,50 +593,712 @@ static const char *parse_hier_part(const char **s, const char **slash, const cha
         path = parse_path_empty(s);
     }
 
-    return path;
+    return PROFILE_EXIT(path);
 }
 
-/* query = *( pchar / "/" / "?" ) */
+/* query = *( pchar / "/" / "?" )
+ * iquery = *( ipchar / iprivate / "/" / "?" ) */
 static const char *parse_query_char(const char **s) {
-    return parse_opt(s, 3, parse_pchar, parse_fwd_slash, parse_question);
+    PROFILE_RULE();
+#if URI_CHARSET == URI_CHARSET_IRI
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_pchar, parse_iprivate, parse_fwd_slash, parse_question));
+#else
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_pchar, parse_fwd_slash, parse_question));
+#endif
 }
 
 static const char *parse_query(const char **s) {
-    return parse_n_star(s, 0, parse_query_char);
+    PROFILE_RULE();
+    return PROFILE_EXIT(parse_n_star(s, 0, parse_query_char));
 }
 
 /* fragment = *( pchar / "/" / "?" ) */
 static const char *parse_fragment_char(const char **s) {
-    return parse_opt(s, 3, parse_pchar, parse_fwd_slash, parse_question);
+    PROFILE_RULE();
+    return PROFILE_EXIT(PARSE_OPT_DISJOINT(s, parse_pchar, parse_fwd_slash, parse_question));
 }
 
 static const char *parse_fragment(const char **s) {
-    return parse_n_star(s, 0, parse_fragment_char);
+    PROFILE_RULE();
+    return PROFILE_EXIT(parse_n_star(s, 0, parse_fragment_char));
 }
 
-/* URI = scheme ":" hier-part [ "?" query ] [ "#" fragment ] */
-URI parse_URI(const char *uri) {
-    const char **s = &uri;
-    URI result = { 0 };
+/* Which component a failed parse stopped in */
+static metrics_reason failure_reason(const URI *result, const char *stop) {
+    return result->scheme   == NULL ? METRICS_FAIL_SCHEME :
+           result->colon_s  == NULL ? METRICS_FAIL_COLON :
+           result->pound    != NULL ? METRICS_FAIL_FRAGMENT :
+           result->question != NULL ? METRICS_FAIL_QUERY :
+           /* nothing of the path was read after the authority */
+           result->slash != NULL && stop == result->path ? METRICS_FAIL_AUTHORITY :
+                                      METRICS_FAIL_PATH;
+}
 
-    if ((result.scheme  = (char*)parse_scheme(s)) == NULL ||
-        (result.colon_s = (char*)parse_colon(s)) == NULL ||
-        /*path can be empty so will always succeed */
-        (result.path    = (char*)parse_hier_part(s, (const char**)&result.slash,
-                                                    (const char**)&result.userinfo,
-                                                    (const char**)&result.atsymbol,
-                                                    (const char**)&result.host,
-                                                    (const char**)&result.colon_p,
-                                                    (const char**)&result.port)) == NULL ||
+/* What can follow each component, so that a parse that stops after it
+ * can tell right away that the rest of the URI won't parse.  The NULL
+ * terminator is in each, as the end of the URI can follow any of them. */
+static const char *const uri_follows[] = { NULL, "/?#", "?#", "#", "" };
+
+/* URI = scheme ":" hier-part [ "?" query ] [ "#" fragment ]
+ * Parses the components after those already in result, up through last,
+ * and sets result->end to where it stopped.  Each component is only
+ * parsed if what comes after it hasn't been found, and parsing one that
+ * isn't present reads nothing, so result alone says where to resume.
+ * Parsing through the fragment checks the URI ends there. */
+static bool parse_URI_components(URI *result, const char **s, URI_component last) {
+    if (result->colon_s == NULL &&
+        ((result->scheme  = (char*)parse_scheme(s)) == NULL ||
+         (result->colon_s = (char*)parse_colon(s)) == NULL)) {
+        return false;
+    }
+    if (last >= URI_AUTHORITY && result->slash == NULL && result->path == NULL) {
+        result->slash = (char*)parse_hier_authority(s, (const char**)&result->userinfo,
+                                                       (const char**)&result->atsymbol,
+                                                       (const char**)&result->host,
+                                                       (const char**)&result->colon_p,
+                                                       (const char**)&result->port);
+    }
+    if (last >= URI_PATH && result->path == NULL) {
+        /* path can be empty so will always succeed */
+        result->path = (char*)parse_hier_path(s, result->slash != NULL);
+    }
+    if (last >= URI_QUERY && result->question == NULL && result->pound == NULL &&
         /* if ? was found but no query */
-        (((result.question = (char*)parse_question(s)) != NULL) &&
-         ((result.query    = (char*)parse_query(s)) == NULL)) ||
+        ((result->question = (char*)parse_question(s)) != NULL) &&
+        ((result->query    = (char*)parse_query(s)) == NULL)) {
+        return false;
+    }
+    if (last >= URI_FRAGMENT && result->pound == NULL &&
         /* if # but no fragment */
-        (((result.pound    = (char*)parse_pound(s)) != NULL) &&
-         ((result.fragment = (char*)parse_fragment(s)) == NULL)) ||
-        (*(result.end      = (char*)*s) != '\0')) {
+        ((result->pound    = (char*)parse_pound(s)) != NULL) &&
+        ((result->fragment = (char*)parse_fragment(s)) == NULL)) {
+        return false;
+    }
+    result->end = (char*)*s;
+    return last == URI_SCHEME || last == URI_AUTHORITY && result->slash == NULL ||
+           strchr(uri_follows[last], **s) != NULL;
+}
+
+#if URI_CHARSET == URI_CHARSET_ASCII
+/* The characters of a host name: ALPHA / DIGIT / "-" / "." / "_" / "~" */
+static bool is_host_name_char(char c) {
+    return c >= 'a' && c <= 'z' || c >= 'A' && c <= 'Z' || c >= '0' && c <= '9' ||
+           c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+/* Most URIs are "http(s)://host[:port]/path[?query][#fragment]" with a
+ * plain host name, and those are scanned here without the grammar: the
+ * delimiters are found with memchr and the rest is checked a class at a
+ * time, as in is_valid_URI below.  On anything else, such as userinfo,
+ * an IP literal, a pct-encoded host or an uppercase scheme, this returns
+ * false without touching result or *s, and the grammar starts over.
+ * What it fills in is exactly what the grammar would. */
+static bool parse_URI_fast(URI *result, const char **s) {
+    const char *p = *s;
+    const char *host = NULL;
+    const char *colon = NULL;
+    const char *path = NULL;
+    const char *question = NULL;
+    const char *pound = NULL;
+    const char *end = NULL;
+    if (p[0] != 'h' || p[1] != 't' || p[2] != 't' || p[3] != 'p') {
+        return false;
+    }
+    p += p[4] == 's' ? 5 : 4;
+    if (p[0] != ':' || p[1] != '/' || p[2] != '/') {
+        return false;
+    }
+    host = p + 3;
+    for (path = host; is_host_name_char(*path); path++);
+    if (path == host) {
+        return false;
+    }
+    if (*path == ':') {
+        for (colon = path++; *path >= '0' && *path <= '9'; path++);
+    }
+    if (*path != '/' && *path != '?' && *path != '#' && *path != '\0') {
+        return false;
+    }
+    /* path, query and fragment, as in is_valid_URI */
+    end = path + strlen(path);
+    if (find_non_uri_char(path, end) != end) {
+        return false;
+    }
+    for (p = path; (p = find_tail_special(p, end)) != end;) {
+        if (*p == '%' && end - p >= 3 && is_hexdig(p[1]) && is_hexdig(p[2])) {
+            p += 3;
+        } else if (*p == '#' && pound == NULL) {
+            pound = p++;
+        } else {
+            return false;
+        }
+    }
+    question = memchr(path, '?', (pound != NULL ? pound : end) - path);
+
+    result->scheme   = (char*)*s;
+    result->colon_s  = (char*)host - 3;
+    result->slash    = (char*)host - 2;
+    result->host     = (char*)host;
+    result->colon_p  = (char*)colon;
+    result->port     = colon != NULL ? (char*)colon + 1 : NULL;
+    result->path     = (char*)path;
+    result->question = (char*)question;
+    result->query    = question != NULL ? (char*)question + 1 : NULL;
+    result->pound    = (char*)pound;
+    result->fragment = pound != NULL ? (char*)pound + 1 : NULL;
+    result->end      = (char*)end;
+    *s = end;
+    return true;
+}
+#endif /* URI_CHARSET_ASCII */
+
+/* URI = scheme ":" hier-part [ "?" query ] [ "#" fragment ]
+ * The error is only looked at on the failure branch, so the success path
+ * is the same whether or not one is asked for. */
+static URI parse_URI_reporting(const char *uri, URI_error *error) {
+    const char **s = &uri;
+    const char *start = uri;
+    const int metered = metrics_enabled;
+    const unsigned long long began = metered ? metrics_now() : 0;
+    URI result = { 0 };
+
+    if (
+#if URI_CHARSET == URI_CHARSET_ASCII
+        !parse_URI_fast(&result, s) &&
+#endif
+        !parse_URI_components(&result, s, URI_FRAGMENT)) {
+        static const URI result_null = { 0 };
+        if (metered) {
+            metrics_record(result.colon_s == NULL ? METRICS_OTHER :
+                           metrics_scheme_of(result.scheme, result.colon_s - result.scheme),
+                           *s - start, failure_reason(&result, *s), began);
+        }
+        if (error != NULL) {
+            error->offset = *s - start;
+            error->component = metrics_reason_name(failure_reason(&result, *s));
+        }
+        result = result_null;
+    } else if (metered) {
+        metrics_record(metrics_scheme_of(result.scheme, result.colon_s - result.scheme),
+                       *s - start, -1, began);
+    }
+    return result;
+}
+
+URI CHARSET_ENTRY(parse_URI)(const char *uri) {
+    PROFILE_RULE();
+    URI result = parse_URI_reporting(uri, NULL);
+    PROFILE_COUNT(result.scheme != NULL);
+    return result;
+}
+
+/* The rest of the API is only in the ASCII build */
+#if URI_CHARSET == URI_CHARSET_ASCII
+URI parse_URI_utf8(const char *);
+URI parse_URI_custom(const char *);
+URI parse_URI_iri(const char *);
+extern __thread const charset *charset_current;
+
+/* The custom charset is saved and restored so that its parsers can
+ * parse with another one */
+URI parse_URI_charset(const charset *cs, const char *uri) {
+    if (cs == NULL || cs == &charset_ascii) {
+        return parse_URI(uri);
+    } else if (cs == &charset_utf8) {
+        return parse_URI_utf8(uri);
+    } else {
+#ifdef URI_NO_CUSTOM_CHARSET
+        static const URI result_null = { 0 };
+        return result_null;
+#else
+        const charset *saved = charset_current;
+        URI result;
+        charset_current = cs;
+        result = parse_URI_custom(uri);
+        charset_current = saved;
+        return result;
+#endif
+    }
+}
+
+/* The UTF-8 is checked all at once up front, so that the grammar only
+ * has to decode it */
+URI parse_IRI(const char *iri) {
+    const char *end = iri + strlen(iri);
+    if (find_invalid_utf8(iri, end) != end) {
+        static const URI result_null = { 0 };
+        return result_null;
+    }
+    return parse_URI_iri(iri);
+}
+
+/* RFC 3987 section 3.1: each byte from 0x80 becomes a pct-encoded
+ * triplet.  The length is counted to the end even once buf is full, so
+ * that the caller can find out how much it needs in one call. */
+char *IRI_to_URI(const char *iri, char *buf, size_t *len) {
+    const char *p = iri;
+    const char *end = iri + strlen(iri);
+    size_t n = 0;
+    while (p < end) {
+        const char *run = p;
+        p = find_non_ascii(p, end);
+        if (n + (p - run) < *len) {
+            memcpy(&buf[n], run, p - run);
+        }
+        n += p - run;
+        if (p < end) {
+            if (n + 3 < *len) {
+                buf[n] = '%';
+                buf[n + 1] = "0123456789ABCDEF"[(unsigned char)*p >> 4];
+                buf[n + 2] = "0123456789ABCDEF"[(unsigned char)*p & 0xF];
+            }
+            n += 3;
+            p++;
+        }
+    }
+    if (n >= *len) {
+        *len = n;
+        return NULL;
+    }
+    buf[n] = '\0';
+    return buf;
+}
+
+URI parse_URI_error(const char *uri, URI_error *error) {
+    PROFILE_RULE();
+    URI result = parse_URI_reporting(uri, error);
+    PROFILE_COUNT(result.scheme != NULL);
+    return result;
+}
+
+URI parse_URI_until(const char *uri, URI_component last) {
+    PROFILE_RULE();
+    URI result = { 0 };
+    if (!parse_URI_components(&result, &uri, last)) {
         static const URI result_null = { 0 };
         result = result_null;
     }
+    PROFILE_COUNT(result.scheme != NULL);
     return result;
 }
+
+URI parse_URI_resume(const URI *partial, URI_component last) {
+    PROFILE_RULE();
+    URI result = *partial;
+    const char *s = partial->end;
+    if (s == NULL || !parse_URI_components(&result, &s, last)) {
+        static const URI result_null = { 0 };
+        result = result_null;
+    }
+    PROFILE_COUNT(result.scheme != NULL);
+    return result;
+}
+
+/* Report a component that parse_URI_components just parsed, along with
+ * the segments or pairs in it.  These are found again with memchr while
+ * the component is still in cache, as the grammar doesn't mark them. */
+static void report_component(const URI *result, URI_component component, const URI_handler *h, void *ctx) {
+    const char *p = NULL;
+    const char *end = NULL;
+    switch (component) {
+    case URI_SCHEME:
+        if (h->field != NULL) {
+            h->field(ctx, URI_FIELD_SCHEME, result->scheme, len_scheme(result));
+        }
+        break;
+    case URI_AUTHORITY:
+        if (h->field != NULL && result->slash != NULL) {
+            if (result->userinfo != NULL) {
+                h->field(ctx, URI_FIELD_USERINFO, result->userinfo, len_userinfo(result));
+            }
+            h->field(ctx, URI_FIELD_HOST, result->host, len_host(result));
+            if (result->port != NULL) {
+                h->field(ctx, URI_FIELD_PORT, result->port, len_port(result));
+            }
+        }
+        break;
+    case URI_PATH:
+        p = result->path;
+        end = p + len_path(result);
+        if (h->field != NULL) {
+            h->field(ctx, URI_FIELD_PATH, p, end - p);
+        }
+        /* path = *( "/" segment ) or segment *( "/" segment ),
+           so a leading segment only comes without a leading "/" */
+        if (h->segment != NULL && p != end) {
+            p += *p == '/';
+            for (;;) {
+                const char *slash = memchr(p, '/', end - p);
+                h->segment(ctx, p, (slash != NULL ? slash : end) - p);
+                if (slash == NULL) {
+                    break;
+                }
+                p = slash + 1;
+            }
+        }
+        break;
+    case URI_QUERY:
+        if (result->question == NULL) {
+            break;
+        }
+        p = result->query;
+        end = p + len_query(result);
+        if (h->field != NULL) {
+            h->field(ctx, URI_FIELD_QUERY, p, end - p);
+        }
+        while (h->query_pair != NULL && p < end) {
+            const char *amp = memchr(p, '&', end - p);
+            const char *stop = amp != NULL ? amp : end;
+            const char *equal = memchr(p, '=', stop - p);
+            if (stop != p) {
+                h->query_pair(ctx, p, (equal != NULL ? equal : stop) - p,
+                              equal != NULL ? equal + 1 : NULL, equal != NULL ? stop - (equal + 1) : 0);
+            }
+            if (amp == NULL) {
+                break;
+            }
+            p = amp + 1;
+        }
+        break;
+    case URI_FRAGMENT:
+        if (h->field != NULL && result->pound != NULL) {
+            h->field(ctx, URI_FIELD_FRAGMENT, result->fragment, len_fragment(result));
+        }
+        break;
+    }
+}
+
+URI parse_URI_events(const char *uri, const URI_handler *handler, void *ctx) {
+    PROFILE_RULE();
+    URI result = { 0 };
+    int component = 0;
+    for (component = URI_SCHEME; component <= URI_FRAGMENT; component++) {
+        if (!parse_URI_components(&result, &uri, (URI_component)component)) {
+            static const URI result_null = { 0 };
+            result = result_null;
+            break;
+        }
+        report_component(&result, (URI_component)component, handler, ctx);
+    }
+    PROFILE_COUNT(result.scheme != NULL);
+    return result;
+}
+
+/* Validation works on the bytes directly rather than through the
+ * parsers above.  Once every byte is known to be one the grammar uses,
+ * what's left to check is where the gen-delims fall and that each "%"
+ * starts a pct-encoded, and after the authority only "%", "#", "[" and
+ * "]" need a second look, so most of the input is only read by the two
+ * vectorized scans. */
+
+/* userinfo and reg-name are both *( unreserved / pct-encoded / sub-delims ),
+ * userinfo also allowing ":".  The span holds no "/", "?" or "#". */
+static bool is_valid_span(const char *p, const char *end, bool colon) {
+    for (; p < end; p++) {
+        if (*p == '%') {
+            if (end - p < 3 || !is_hexdig(p[1]) || !is_hexdig(p[2])) {
+                return false;
+            }
+            p += 2;
+        } else if (*p == '[' || *p == ']' || *p == '@' || *p == ':' && !colon) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* port = *DIGIT */
+static bool is_valid_port(const char *p, const char *end) {
+    for (; p < end && *p >= '0' && *p <= '9'; p++);
+    return p == end;
+}
+
+/* IP-literal = "[" ( IPv6address / IPvFuture  ) "]"
+ * An IPv6address is at most 45 characters, so it's copied out and
+ * handed to parse_IP_literal to accept exactly what parse_URI does. */
+static bool is_valid_IP_literal(const char *p, const char *end) {
+    if (p[1] == 'v') {
+#ifdef URI_NO_IPVFUTURE
+        return false;
+#else
+        /* IPvFuture = "v" 1*HEXDIG "." 1*( unreserved / sub-delims / ":" ) */
+        const char *hex = p + 2;
+        const char *q = hex;
+        for (; is_hexdig(*q); q++);
+        if (q == hex || *q != '.' || ++q == end - 1) {
+            return false;
+        }
+        for (; q < end - 1 && (is_host_name_char(*q) || *q == ':' ||
+                               *q != '\0' && strchr("!$&'()*+,;=", *q) != NULL); q++);
+        return q == end - 1;
+#endif /* URI_NO_IPVFUTURE */
+    }
+#ifndef URI_NO_IPV6
+    if (end - p <= 47) {
+        char literal[48];
+        const char *s = literal;
+        memcpy(literal, p, end - p);
+        literal[end - p] = '\0';
+        return parse_IP_literal(&s) != NULL && *s == '\0';
+    }
+#else
+    (void)end;
+#endif /* URI_NO_IPV6 */
+    return false;
+}
+
+/* authority = [ userinfo "@" ] host [ ":" port ]
+ * host = IP-literal / IPv4address / reg-name
+ * IPv4address is contained by reg-name */
+static bool is_valid_authority(const char *p, const char *end) {
+    const char *at = memchr(p, '@', end - p);
+    const char *colon = NULL;
+    if (at != NULL) {
+#ifdef URI_NO_USERINFO
+        return false;
+#endif
+        if (!is_valid_span(p, at, true)) {
+            return false;
+        }
+        p = at + 1;
+    }
+    if (p < end && *p == '[') {
+        const char *rbracket = memchr(p, ']', end - p);
+        if (rbracket == NULL || !is_valid_IP_literal(p, rbracket + 1)) {
+            return false;
+        }
+        colon = rbracket + 1;
+        if (colon < end && *colon != ':') {
+            return false;
+        }
+    } else {
+        colon = memchr(p, ':', end - p);
+        if (!is_valid_span(p, colon != NULL ? colon : end, false)) {
+            return false;
+        }
+    }
+    return colon == NULL || colon == end || is_valid_port(colon + 1, end);
+}
+
+int is_valid_URI(const char *uri, size_t len) {
+    const char *end = uri + len;
+    const char *p = uri;
+    bool pound = false;
+    if (find_non_uri_char(p, end) != end) {
+        return 0;
+    }
+    /* scheme = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." ) */
+    if (p == end || !(*p >= 'A' && *p <= 'Z' || *p >= 'a' && *p <= 'z')) {
+        return 0;
+    }
+    for (p++; p < end && (*p >= 'A' && *p <= 'Z' || *p >= 'a' && *p <= 'z' ||
+                          *p >= '0' && *p <= '9' || *p == '+' || *p == '-' || *p == '.'); p++);
+    if (p == end || *p != ':') {
+        return 0;
+    }
+    p++;
+    /* hier-part = "//" authority path-abempty / path-absolute / path-rootless / path-empty
+     * Past the authority all of these are any run of pchar and "/" */
+    if (end - p >= 2 && p[0] == '/' && p[1] == '/') {
+        const char *authority = p += 2;
+        for (; p < end && *p != '/' && *p != '?' && *p != '#'; p++);
+        if (!is_valid_authority(authority, p)) {
+            return 0;
+        }
+    }
+    /* path, "?" query and "#" fragment only differ in that the fragment
+     * can't hold another "#", and none of them can hold "[" or "]" */
+    while ((p = find_tail_special(p, end)) != end) {
+        if (*p == '%' && end - p >= 3 && is_hexdig(p[1]) && is_hexdig(p[2])) {
+            p += 3;
+        } else if (*p == '#' && !pound) {
+            pound = true;
+            p++;
+        } else {
+            return 0;
+        }
+    }
+    return 1;
+}
+/* Checks for the components of build_URI and edit_URI, which unlike the
+ * rest of is_valid_URI can't rely on the delimiters around them. */
+
+/* Whether [p, end) holds none of the characters in set */
+static bool has_none(const char *p, const char *end, const char *set) {
+    for (; p < end; p++) {
+        if (strchr(set, *p) != NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* scheme = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." ) */
+static bool is_valid_scheme(const char *p, const char *end) {
+    if (p == end || !(*p >= 'A' && *p <= 'Z' || *p >= 'a' && *p <= 'z')) {
+        return false;
+    }
+    for (p++; p < end && (*p >= 'A' && *p <= 'Z' || *p >= 'a' && *p <= 'z' ||
+                          *p >= '0' && *p <= '9' || *p == '+' || *p == '-' || *p == '.'); p++);
+    return p == end;
+}
+
+/* path = *( pchar / "/" ), and query and fragment also allow "?" */
+static bool is_valid_tail(const char *p, const char *end, bool question) {
+    if (find_non_uri_char(p, end) != end || (!question && memchr(p, '?', end - p) != NULL)) {
+        return false;
+    }
+    while ((p = find_tail_special(p, end)) != end) {
+        if (*p == '%' && end - p >= 3 && is_hexdig(p[1]) && is_hexdig(p[2])) {
+            p += 3;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool is_valid_field(URI_field field, const char *p, const char *end) {
+    if (field == URI_FIELD_SCHEME) {
+        return is_valid_scheme(p, end);
+    } else if (field == URI_FIELD_PORT) {
+        return is_valid_port(p, end);
+    } else if (field >= URI_FIELD_PATH) {
+        return is_valid_tail(p, end, field != URI_FIELD_PATH);
+    } else if (find_non_uri_char(p, end) != end || !has_none(p, end, "/?#")) {
+        return false;
+    } else if (field == URI_FIELD_USERINFO) {
+#ifdef URI_NO_USERINFO
+        return false;
+#else
+        return is_valid_span(p, end, true);
+#endif
+    } else if (p < end && *p == '[') {
+        return end - p >= 2 && end[-1] == ']' && is_valid_IP_literal(p, end);
+    }
+    return is_valid_span(p, end, false);
+}
+
+/* Writes the parts out with their delimiters and sets each field and
+ * delimiter where parse_URI would have.  Only the parts in check are
+ * checked against the grammar, and how they fit together always is.
+ * extra, if not NULL, is added to the query after an "&". */
+static URI build(const URI_views *parts, unsigned int check, const URI_view *extra, char *buf, size_t *len) {
+    static const URI result_null = { 0 };
+    const URI_view *v = parts->field;
+    const char *path = v[URI_FIELD_PATH].ptr ? v[URI_FIELD_PATH].ptr : "";
+    size_t path_len = v[URI_FIELD_PATH].ptr ? v[URI_FIELD_PATH].len : 0;
+    bool query = v[URI_FIELD_QUERY].ptr != NULL || extra != NULL;
+    bool amp = extra != NULL && v[URI_FIELD_QUERY].len > 0;
+    size_t needed = 0;
+    URI result = result_null;
+    char *o = buf;
+    int i = 0;
+    for (i = 0; i < URI_FIELDS; i++) {
+        if ((check & 1u << i) && v[i].ptr != NULL &&
+            !is_valid_field((URI_field)i, v[i].ptr, v[i].ptr + v[i].len)) {
+            *len = 0;
+            return result_null;
+        }
+    }
+    if (v[URI_FIELD_SCHEME].ptr == NULL ||
+        (extra != NULL && !is_valid_tail(extra->ptr, extra->ptr + extra->len, true)) ||
+        (v[URI_FIELD_HOST].ptr == NULL ?
+         v[URI_FIELD_USERINFO].ptr != NULL || v[URI_FIELD_PORT].ptr != NULL ||
+         (path_len >= 2 && path[0] == '/' && path[1] == '/') :
+         path_len > 0 && path[0] != '/')) {
+        *len = 0;
+        return result_null;
+    }
+
+    needed = v[URI_FIELD_SCHEME].len + 1 + path_len;
+    if (v[URI_FIELD_HOST].ptr != NULL) {
+        needed += 2 + v[URI_FIELD_HOST].len +
+                  (v[URI_FIELD_USERINFO].ptr ? v[URI_FIELD_USERINFO].len + 1 : 0) +
+                  (v[URI_FIELD_PORT].ptr ? v[URI_FIELD_PORT].len + 1 : 0);
+    }
+    if (query) {
+        needed += 1 + v[URI_FIELD_QUERY].len + (extra ? extra->len + amp : 0);
+    }
+    if (v[URI_FIELD_FRAGMENT].ptr != NULL) {
+        needed += 1 + v[URI_FIELD_FRAGMENT].len;
+    }
+    if (needed >= *len) {
+        *len = needed;
+        return result_null;
+    }
+
+#define PUT(field, start, n) \
+    result.field = o; \
+    memcpy(o, start, n); \
+    o += n
+#define DELIMIT(field, c) \
+    result.field = o; \
+    *o++ = c
+    PUT(scheme, v[URI_FIELD_SCHEME].ptr, v[URI_FIELD_SCHEME].len);
+    DELIMIT(colon_s, ':');
+    if (v[URI_FIELD_HOST].ptr != NULL) {
+        DELIMIT(slash, '/');
+        *o++ = '/';
+        if (v[URI_FIELD_USERINFO].ptr != NULL) {
+            PUT(userinfo, v[URI_FIELD_USERINFO].ptr, v[URI_FIELD_USERINFO].len);
+            DELIMIT(atsymbol, '@');
+        }
+        PUT(host, v[URI_FIELD_HOST].ptr, v[URI_FIELD_HOST].len);
+        if (v[URI_FIELD_PORT].ptr != NULL) {
+            DELIMIT(colon_p, ':');
+            PUT(port, v[URI_FIELD_PORT].ptr, v[URI_FIELD_PORT].len);
+        }
+    }
+    PUT(path, path, path_len);
+    if (query) {
+        DELIMIT(question, '?');
+        PUT(query, v[URI_FIELD_QUERY].ptr, v[URI_FIELD_QUERY].len);
+        if (extra != NULL) {
+            if (amp) {
+                *o++ = '&';
+            }
+            memcpy(o, extra->ptr, extra->len);
+            o += extra->len;
+        }
+    }
+    if (v[URI_FIELD_FRAGMENT].ptr != NULL) {
+        DELIMIT(pound, '#');
+        PUT(fragment, v[URI_FIELD_FRAGMENT].ptr, v[URI_FIELD_FRAGMENT].len);
+    }
+#undef PUT
+#undef DELIMIT
+    *o = '\0';
+    result.end = o;
+    return result;
+}
+
+URI build_URI(const URI_views *parts, char *buf, size_t *len) {
+    return build(parts, URI_ALL_FIELDS, NULL, buf, len);
+}
+
+URI edit_URI(const URI *uri, URI_field field, const char *value, size_t value_len, char *buf, size_t *len) {
+    static const URI result_null = { 0 };
+    URI_views parts = get_URI_views(uri);
+    if (uri->scheme == NULL || (unsigned int)field >= URI_FIELDS) {
+        *len = 0;
+        return result_null;
+    }
+    parts.field[field].ptr = value;
+    parts.field[field].len = value != NULL ? value_len : 0;
+    return build(&parts, 1u << field, NULL, buf, len);
+}
+
+URI append_URI_query(const URI *uri, const char *pair, size_t pair_len, char *buf, size_t *len) {
+    static const URI result_null = { 0 };
+    URI_views parts = get_URI_views(uri);
+    URI_view extra;
+    if (uri->scheme == NULL) {
+        *len = 0;
+        return result_null;
+    }
+    extra.ptr = pair;
+    extra.len = pair_len;
+    return build(&parts, 0, &extra, buf, len);
+}
+#endif /* URI_CHARSET_ASCII */
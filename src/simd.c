@@ -0,0 +1,323 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "simd_kernels.h"
+#include "chars.h"
+
+#include <stddef.h>
+
+/* Each level describes a vector of WIDTH bytes and comparisons on it,
+ * and the scans below are written once against these.  A comparison
+ * gives a cmp, which BITS turns into one bit per byte, lowest first. */
+#if URI_SIMD == URI_SIMD_SSE2 && defined(__SSE2__)
+#include <emmintrin.h>
+#define WIDTH 16
+typedef __m128i vec;
+typedef __m128i cmp;
+#define LOAD(p)      _mm_loadu_si128((const __m128i *)(p))
+#define SET1(c)      _mm_set1_epi8(c)
+#define EQ(a, b)     _mm_cmpeq_epi8(a, b)
+#define GT(a, b)     _mm_cmpgt_epi8(a, b)
+#define OR(a, b)     _mm_or_si128(a, b)
+#define AND(a, b)    _mm_and_si128(a, b)
+#define ANDNOT(a, b) _mm_andnot_si128(a, b)
+#define HIGH(c)      (c)
+#define DIGITS(c)    ({ vec _v = _mm_sub_epi8(c, SET1('0')); \
+                        EQ(_mm_min_epu8(_v, SET1(9)), _v); })
+#define BITS(m)      ((unsigned long long)(unsigned)_mm_movemask_epi8(m))
+#elif URI_SIMD == URI_SIMD_AVX2 && defined(__AVX2__)
+#include <immintrin.h>
+#define WIDTH 32
+typedef __m256i vec;
+typedef __m256i cmp;
+#define LOAD(p)      _mm256_loadu_si256((const __m256i *)(p))
+#define SET1(c)      _mm256_set1_epi8(c)
+#define EQ(a, b)     _mm256_cmpeq_epi8(a, b)
+#define GT(a, b)     _mm256_cmpgt_epi8(a, b)
+#define OR(a, b)     _mm256_or_si256(a, b)
+#define AND(a, b)    _mm256_and_si256(a, b)
+#define ANDNOT(a, b) _mm256_andnot_si256(a, b)
+#define HIGH(c)      (c)
+#define DIGITS(c)    ({ vec _v = _mm256_sub_epi8(c, SET1('0')); \
+                        EQ(_mm256_min_epu8(_v, SET1(9)), _v); })
+#define BITS(m)      ((unsigned long long)(unsigned)_mm256_movemask_epi8(m))
+#elif URI_SIMD == URI_SIMD_AVX512 && defined(__AVX512BW__)
+#include <immintrin.h>
+#define WIDTH 64
+typedef __m512i vec;
+typedef __mmask64 cmp;
+#define LOAD(p)      _mm512_loadu_si512((const void *)(p))
+#define SET1(c)      _mm512_set1_epi8(c)
+#define EQ(a, b)     _mm512_cmpeq_epi8_mask(a, b)
+#define GT(a, b)     _mm512_cmpgt_epi8_mask(a, b)
+#define OR(a, b)     ((a) | (b))
+#define AND(a, b)    ((a) & (b))
+#define ANDNOT(a, b) (~(a) & (b))
+#define HIGH(c)      _mm512_movepi8_mask(c)
+#define DIGITS(c)    _mm512_cmple_epu8_mask(_mm512_sub_epi8(c, SET1('0')), SET1(9))
+#define BITS(m)      ((unsigned long long)(m))
+/* Masked loads don't fault on the bytes left out, so the last partial
+ * vector is scanned as well instead of a byte at a time */
+#define TAIL(n)      ((n) >= WIDTH ? ~0ULL : (1ULL << (n)) - 1)
+#define LOAD_TAIL(p, n) _mm512_maskz_loadu_epi8(TAIL(n), (const void *)(p))
+#endif
+
+#ifdef WIDTH
+#define ALL (WIDTH == 64 ? ~0ULL : (1ULL << WIDTH) - 1)
+
+/* Return the first byte in [p, end) that bits marks, a vector at a time
+ * and then, where the level can, the rest as one partial vector.  The
+ * scalar loop after it handles whatever is left. */
+#ifdef LOAD_TAIL
+#define SCAN(p, end, bits) \
+    for (; (end) - (p) >= WIDTH; (p) += WIDTH) { \
+        unsigned long long _m = bits(LOAD(p)); \
+        if (_m != 0) { \
+            return (p) + __builtin_ctzll(_m); \
+        } \
+    } \
+    if ((p) < (end)) { \
+        unsigned long long _m = bits(LOAD_TAIL(p, (end) - (p))) & TAIL((end) - (p)); \
+        return _m != 0 ? (p) + __builtin_ctzll(_m) : (end); \
+    }
+#else
+#define SCAN(p, end, bits) \
+    for (; (end) - (p) >= WIDTH; (p) += WIDTH) { \
+        unsigned long long _m = bits(LOAD(p)); \
+        if (_m != 0) { \
+            return (p) + __builtin_ctzll(_m); \
+        } \
+    }
+#endif
+
+/* Bytes from 0x80 are negative, so the signed comparison with space
+ * excludes them along with the controls */
+static unsigned long long non_uri_chars(vec c) {
+    cmp in = AND(GT(c, SET1(' ')), GT(SET1(0x7f), c));
+    cmp out = EQ(c, SET1('"'));
+    out = OR(out, EQ(c, SET1('<')));
+    out = OR(out, EQ(c, SET1('>')));
+    out = OR(out, EQ(c, SET1('\\')));
+    out = OR(out, EQ(c, SET1('^')));
+    out = OR(out, EQ(c, SET1('`')));
+    out = OR(out, EQ(c, SET1('{')));
+    out = OR(out, EQ(c, SET1('|')));
+    out = OR(out, EQ(c, SET1('}')));
+    return ~BITS(ANDNOT(out, in)) & ALL;
+}
+
+static unsigned long long tail_specials(vec c) {
+    cmp in = EQ(c, SET1('%'));
+    in = OR(in, EQ(c, SET1('#')));
+    in = OR(in, EQ(c, SET1('[')));
+    in = OR(in, EQ(c, SET1(']')));
+    return BITS(in);
+}
+
+static unsigned long long non_ascii(vec c) {
+    return BITS(HIGH(c));
+}
+
+static unsigned long long digits(vec c) {
+    return BITS(DIGITS(c));
+}
+
+static unsigned long long run_ends(vec c) {
+    cmp in = DIGITS(c);
+    in = OR(in, EQ(c, SET1('+')));
+    in = OR(in, EQ(c, SET1('-')));
+    in = OR(in, EQ(c, SET1('.')));
+    in = OR(in, EQ(c, SET1('(')));
+    in = OR(in, EQ(c, SET1(')')));
+    in = OR(in, EQ(c, SET1(' ')));
+    return ~BITS(in) & ALL;
+}
+
+/* "--" is found by comparing each byte and the one after it */
+static unsigned long long idna_specials(vec c, vec next) {
+    cmp dashes = AND(EQ(c, SET1('-')), EQ(next, SET1('-')));
+    return BITS(OR(OR(HIGH(c), EQ(c, SET1('%'))), dashes));
+}
+#else
+#define SCAN(p, end, bits)
+#endif /* WIDTH */
+
+static const char *SIMD_ENTRY(find_non_uri_char)(const char *p, const char *end) {
+    SCAN(p, end, non_uri_chars);
+    for (; p < end && is_uri_char(*p); p++);
+    return p;
+}
+
+static const char *SIMD_ENTRY(find_tail_special)(const char *p, const char *end) {
+    SCAN(p, end, tail_specials);
+    for (; p < end && *p != '%' && *p != '#' && *p != '[' && *p != ']'; p++);
+    return p;
+}
+
+static const char *SIMD_ENTRY(find_non_ascii)(const char *p, const char *end) {
+    SCAN(p, end, non_ascii);
+    for (; p < end && (unsigned char)*p < 0x80; p++);
+    return p;
+}
+
+static const char *SIMD_ENTRY(find_idna_special)(const char *p, const char *end) {
+#ifdef WIDTH
+    for (; end - p >= WIDTH + 1; p += WIDTH) {
+        unsigned long long mask = idna_specials(LOAD(p), LOAD(p + 1));
+        if (mask != 0) {
+            return p + __builtin_ctzll(mask);
+        }
+    }
+#ifdef LOAD_TAIL
+    if (p < end) {
+        unsigned long long mask = idna_specials(LOAD_TAIL(p, end - p), LOAD_TAIL(p + 1, end - p - 1)) &
+                                  TAIL(end - p);
+        return mask != 0 ? p + __builtin_ctzll(mask) : end;
+    }
+#endif
+#endif
+    for (; p < end && (unsigned char)*p < 0x80 && *p != '%' &&
+           !(*p == '-' && p + 1 < end && p[1] == '-'); p++);
+    return p;
+}
+
+static const char *SIMD_ENTRY(find_digit)(const char *p, const char *end) {
+    SCAN(p, end, digits);
+    for (; p < end && (*p < '0' || *p > '9'); p++);
+    return p;
+}
+
+static const char *SIMD_ENTRY(find_run_end)(const char *p, const char *end) {
+    SCAN(p, end, run_ends);
+    for (; p < end && ((*p >= '0' && *p <= '9') || *p == '+' || *p == '-' || *p == '.' ||
+                       *p == '(' || *p == ')' || *p == ' '); p++);
+    return p;
+}
+
+#if URI_SIMD == URI_SIMD_SCALAR || defined(WIDTH)
+const simd_kernels SIMD_ENTRY(simd_kernels) = {
+    SIMD_ENTRY(find_non_uri_char),
+    SIMD_ENTRY(find_tail_special),
+    SIMD_ENTRY(find_non_ascii),
+    SIMD_ENTRY(find_idna_special),
+    SIMD_ENTRY(find_digit),
+    SIMD_ENTRY(find_run_end)
+};
+#else
+/* Built without the instruction set, so never picked */
+const simd_kernels SIMD_ENTRY(simd_kernels) = { NULL, NULL, NULL, NULL, NULL, NULL };
+#endif
+
+/* The dispatch is only in the scalar build, which is always there */
+#if URI_SIMD == URI_SIMD_SCALAR
+
+/* Scalar until simd_init runs, so that a constructor elsewhere that
+ * parses before it does still works */
+simd_kernels simd_active = {
+    find_non_uri_char_scalar,
+    find_tail_special_scalar,
+    find_non_ascii_scalar,
+    find_idna_special_scalar,
+    find_digit_scalar,
+    find_run_end_scalar
+};
+
+static simd_level active_level = SIMD_SCALAR;
+
+static const simd_kernels *kernels(simd_level level) {
+    switch (level) {
+    case SIMD_SCALAR:
+        return &simd_kernels_scalar;
+#if defined(__x86_64__) || defined(__i386__)
+    case SIMD_SSE2:
+        return &simd_kernels_sse2;
+    case SIMD_AVX2:
+        return &simd_kernels_avx2;
+    case SIMD_AVX512:
+        return &simd_kernels_avx512;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+int simd_supported(simd_level level) {
+    const simd_kernels *k = kernels(level);
+    if (k == NULL || k->find_non_uri_char == NULL) {
+        return 0;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    switch (level) {
+    case SIMD_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case SIMD_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case SIMD_AVX512:
+        return __builtin_cpu_supports("avx512bw");
+    default:
+        break;
+    }
+#endif
+    return level == SIMD_SCALAR;
+}
+
+int simd_set_level(simd_level level) {
+    if (!simd_supported(level)) {
+        return 0;
+    }
+    simd_active = *kernels(level);
+    active_level = level;
+    return 1;
+}
+
+simd_level simd_get_level(void) {
+    return active_level;
+}
+
+const char *simd_level_name(simd_level level) {
+    static const char *names[SIMD_LEVELS] = { "scalar", "sse2", "avx2", "avx512" };
+    return level < SIMD_LEVELS ? names[level] : NULL;
+}
+
+/* Picks the level once, when the library is loaded */
+__attribute__((constructor))
+static void simd_init(void) {
+#ifdef URI_SIMD_FORCE
+    simd_set_level(URI_SIMD_FORCE);
+#else
+    int level = SIMD_LEVELS - 1;
+    for (; level > SIMD_SCALAR && !simd_set_level((simd_level)level); level--);
+#endif
+}
+
+#endif /* URI_SIMD == URI_SIMD_SCALAR */
@@ -0,0 +1,83 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef URI_PATH_FINDER_SIMD_KERNELS_H
+#define URI_PATH_FINDER_SIMD_KERNELS_H
+
+#include "simd.h"
+
+/* simd.c is compiled once for each level in URI_SIMD, the same way the
+ * grammars are compiled for each charset, see chars.h.  The values are
+ * those of simd_level. */
+#define URI_SIMD_SCALAR 0
+#define URI_SIMD_SSE2   1
+#define URI_SIMD_AVX2   2
+#define URI_SIMD_AVX512 3
+
+#ifndef URI_SIMD
+#define URI_SIMD URI_SIMD_SCALAR
+#endif
+
+#if URI_SIMD == URI_SIMD_SCALAR
+#define SIMD_ENTRY(name) name##_scalar
+#elif URI_SIMD == URI_SIMD_SSE2
+#define SIMD_ENTRY(name) name##_sse2
+#elif URI_SIMD == URI_SIMD_AVX2
+#define SIMD_ENTRY(name) name##_avx2
+#elif URI_SIMD == URI_SIMD_AVX512
+#define SIMD_ENTRY(name) name##_avx512
+#endif
+
+/* Each returns the first byte in [p, end) of its class, or end */
+typedef const char *(*simd_scan)(const char *p, const char *end);
+
+typedef struct simd_kernels {
+    simd_scan find_non_uri_char;   /* not used by either grammar */
+    simd_scan find_tail_special;   /* "%", "#", "[" or "]" */
+    simd_scan find_non_ascii;      /* from 0x80 */
+    simd_scan find_idna_special;   /* from 0x80, "%", or "--" */
+    simd_scan find_digit;          /* DIGIT */
+    simd_scan find_run_end;        /* not DIGIT / "+" / "-" / "." / "(" / ")" / " " */
+} simd_kernels;
+
+/* One per level, with NULL scans if it was built without the
+ * instruction set, e.g. on other architectures */
+extern const simd_kernels simd_kernels_scalar;
+extern const simd_kernels simd_kernels_sse2;
+extern const simd_kernels simd_kernels_avx2;
+extern const simd_kernels simd_kernels_avx512;
+
+/* The scans of the level in use, copied so a scan is a single load and
+ * an indirect call */
+extern simd_kernels simd_active;
+
+#endif /* URI_PATH_FINDER_SIMD_KERNELS_H */
@@ -0,0 +1,193 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tel_prefix.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/* Each edge holds the index of the child node shifted left by one,
+ * with the low bit set if a prefix ends at that child.  The root is
+ * node 0, which is never a child, so an edge of 0 means no child. */
+#define EDGE_NODE(e)     ((e) >> 1)
+#define EDGE_TERMINAL(e) ((e) & 1u)
+
+/* Lookups in a batch run in lockstep, one digit each per round */
+#define TEL_PREFIX_BATCH 8
+
+#ifdef __GNUC__
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p)
+#endif
+
+/* HEXDIG = DIGIT / "A" / "B" / "C" / "D" / "E" / "F" */
+static int digit_index(char c) {
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    }
+    if ((c >= 'A') && (c <= 'F')) {
+        return c - 'A' + 10;
+    }
+    if ((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+/* visual-separator = "-" / "." / "(" / ")" */
+static int is_visual_separator(char c) {
+    return c == '-' || c == '.' || c == '(' || c == ')';
+}
+
+void tel_prefix_init(tel_prefix_table *t, tel_prefix_node *nodes, unsigned int *values, size_t size) {
+    t->size = size;
+    t->entries = 1;
+    t->nodes = nodes;
+    t->values = values;
+    memset(&nodes[0], 0, sizeof(nodes[0]));
+    values[0] = 0;
+}
+
+int tel_prefix_insert(tel_prefix_table *t, const char *prefix, size_t len, unsigned int value) {
+    const char *stop = prefix + len;
+    const char *p = NULL;
+    unsigned int node = 0;
+    unsigned int *edge = NULL;
+    if (value == 0) {
+        return 0;
+    }
+    if (prefix < stop && *prefix == '+') {
+        prefix++;
+    }
+    /* Check everything up front so a bad prefix doesn't leave nodes behind */
+    for (p = prefix; p < stop; p++) {
+        if (digit_index(*p) < 0 && !is_visual_separator(*p)) {
+            return 0;
+        }
+    }
+    for (p = prefix; p < stop; p++) {
+        int d = digit_index(*p);
+        if (d < 0) {
+            continue;
+        }
+        edge = &t->nodes[node].child[d];
+        if (*edge == 0) {
+            if (t->entries == t->size) {
+                return 0;
+            }
+            memset(&t->nodes[t->entries], 0, sizeof(t->nodes[0]));
+            t->values[t->entries] = 0;
+            *edge = (unsigned int)t->entries++ << 1;
+        }
+        node = EDGE_NODE(*edge);
+    }
+    if (edge == NULL || EDGE_TERMINAL(*edge)) {
+        /* Either there were no digits, or it's a duplicate */
+        return 0;
+    }
+    *edge |= 1u;
+    t->values[node] = value;
+    return 1;
+}
+
+/* Advance one digit from *node, skipping visual separators.  Returns
+ * 0 once the number or the matching prefixes run out. */
+static int tel_prefix_step(const tel_prefix_table *t, const char **p, const char *stop, unsigned int *node, unsigned int *best) {
+    for (; *p < stop; (*p)++) {
+        int d = digit_index(**p);
+        if (d >= 0) {
+            unsigned int edge = t->nodes[*node].child[d];
+            if (edge == 0) {
+                break;
+            }
+            *node = EDGE_NODE(edge);
+            if (EDGE_TERMINAL(edge)) {
+                *best = *node;
+            }
+            (*p)++;
+            return 1;
+        } else if (!is_visual_separator(**p)) {
+            break;
+        }
+    }
+    *p = stop;
+    return 0;
+}
+
+unsigned int tel_prefix_lookup(const tel_prefix_table *t, const Tel *tel) {
+    const char *p = NULL;
+    unsigned int node = 0;
+    unsigned int best = 0;
+    if (tel->global_number == NULL) {
+        return 0;
+    }
+    /* Skip the "+" of global-number-digits */
+    p = tel->global_number + 1;
+    while (tel_prefix_step(t, &p, tel->number_stop, &node, &best));
+    return best ? t->values[best] : 0;
+}
+
+void tel_prefix_lookup_n(const tel_prefix_table *t, const Tel *tels, size_t n, unsigned int *values) {
+    size_t i = 0;
+    for (i = 0; i < n; i += TEL_PREFIX_BATCH) {
+        const char *p[TEL_PREFIX_BATCH];
+        const char *stop[TEL_PREFIX_BATCH];
+        unsigned int node[TEL_PREFIX_BATCH];
+        unsigned int best[TEL_PREFIX_BATCH];
+        size_t m = n - i < TEL_PREFIX_BATCH ? n - i : TEL_PREFIX_BATCH;
+        size_t j = 0;
+        int active = 0;
+        for (j = 0; j < m; j++) {
+            const Tel *tel = &tels[i + j];
+            p[j] = tel->global_number ? tel->global_number + 1 : NULL;
+            stop[j] = tel->global_number ? tel->number_stop : NULL;
+            node[j] = 0;
+            best[j] = 0;
+        }
+        do {
+            /* Every lookup takes one step per round, and the node it
+               lands on is fetched while the others take theirs */
+            active = 0;
+            for (j = 0; j < m; j++) {
+                if (p[j] < stop[j] &&
+                    tel_prefix_step(t, &p[j], stop[j], &node[j], &best[j])) {
+                    PREFETCH(&t->nodes[node[j]]);
+                    active = 1;
+                }
+            }
+        } while (active);
+        for (j = 0; j < m; j++) {
+            values[i + j] = best[j] ? t->values[best[j]] : 0;
+        }
+    }
+}
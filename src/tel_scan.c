@@ -0,0 +1,156 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tel_scan.h"
+#include "simd_kernels.h"
+
+#include <stddef.h>
+#include <string.h>
+
+static const char context_par[] = ";phone-context=";
+static const char tel[] = "tel:";
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static int is_alpha(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+}
+
+/* Runs are made of DIGIT / "+" / visual-separator / " " */
+static int is_run_char(char c) {
+    return is_digit(c) || c == '+' || c == '-' || c == '.' ||
+           c == '(' || c == ')' || c == ' ';
+}
+
+/* Find the first digit, a vector at a time, see simd.c */
+static const char *find_digit(const char *p, const char *end) {
+    return simd_active.find_digit(p, end);
+}
+
+/* Find the end of a run, a vector at a time */
+static const char *find_run_end(const char *p, const char *end) {
+    return simd_active.find_run_end(p, end);
+}
+
+/* Write the candidate as a tel URI into buf, or return 0 if it
+ * doesn't fit.  Spaces aren't visual separators, so they become "-". */
+static size_t write_uri(char *buf, size_t buf_len, const char *start, const char *stop, const char *context) {
+    size_t len = sizeof(tel) - 1 + (stop - start) + 1;
+    size_t context_len = 0;
+    char *out = buf;
+    if (*start != '+') {
+        context_len = strlen(context);
+        len += sizeof(context_par) - 1 + context_len;
+    }
+    if (len > buf_len) {
+        return 0;
+    }
+    memcpy(out, tel, sizeof(tel) - 1);
+    out += sizeof(tel) - 1;
+    for (; start < stop; start++) {
+        *out++ = *start == ' ' ? '-' : *start;
+    }
+    if (context_len != 0) {
+        memcpy(out, context_par, sizeof(context_par) - 1);
+        out += sizeof(context_par) - 1;
+        memcpy(out, context, context_len);
+        out += context_len;
+    }
+    *out = '\0';
+    return len;
+}
+
+size_t scan_telephone(const char *text, size_t len, const char *context, unsigned int min_digits,
+                      tel_match *matches, size_t n, char *buf, size_t buf_len) {
+    const char *end = text + len;
+    const char *p = text;
+    size_t found = 0;
+    while (found < n) {
+        /* Everything before from has been scanned */
+        const char *from = p;
+        const char *digit = p = find_digit(p, end);
+        const char *start = p;
+        const char *stop = NULL;
+        const char *q = NULL;
+        unsigned int digits = 0;
+        size_t uri_len = 0;
+        if (digit == end) {
+            break;
+        }
+        stop = find_run_end(digit, end);
+
+        /* Only the first "+" can be part of the number, so a later
+           one ends the run and starts the next */
+        for (q = digit; q < stop && *q != '+'; q++);
+        stop = q;
+        p = stop;
+
+        /* Back up over what precedes the first digit, then trim the
+           run so it starts at "+", "(" or a digit and ends at a digit */
+        while (start > from && is_run_char(start[-1])) {
+            start--;
+        }
+        for (; start < digit && *start != '+' && *start != '('; start++);
+        while (stop > digit && !is_digit(stop[-1])) {
+            stop--;
+        }
+
+        /* Numbers aren't part of words */
+        if ((start > text && (is_alpha(start[-1]) || is_digit(start[-1]))) ||
+            (stop < end && is_alpha(*stop))) {
+            continue;
+        }
+        for (q = start; q < stop; q++) {
+            digits += is_digit(*q);
+        }
+        if (digits < min_digits || (*start != '+' && context == NULL)) {
+            continue;
+        }
+
+        if ((uri_len = write_uri(buf, buf_len, start, stop, context)) == 0) {
+            break;
+        }
+        matches[found].tel = parse_telephone(buf);
+        if (matches[found].tel.global_number != NULL ||
+            matches[found].tel.local_number != NULL) {
+            matches[found].start = start;
+            matches[found].stop = stop;
+            matches[found].uri = buf;
+            buf += uri_len;
+            buf_len -= uri_len;
+            found++;
+        }
+    }
+    return found;
+}
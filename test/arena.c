@@ -0,0 +1,154 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "arena.h"
+#include "rfc_3986.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+/* Parses p_url from a buffer that's then overwritten, so the URI has to
+ * point into the arena, at the same offsets parse_URI finds in place */
+URI test_parse(URI_arena *p_arena, const char *p_url)
+{
+    char buf[256];
+    URI expected = parse_URI(p_url);
+    URI result;
+    size_t used = URI_arena_used(p_arena);
+    strcpy(buf, p_url);
+    result = parse_URI_into_arena(p_arena, buf);
+    memset(buf, 'x', sizeof(buf));
+    if (expected.scheme == NULL) {
+        if (result.scheme != NULL || result.end != NULL || URI_arena_used(p_arena) != used) {
+            printf("Failed invalid URI into arena: %s\n", p_url);
+            failures++;
+        }
+        return result;
+    }
+#define CHECK(member) (result.member == NULL ? expected.member == NULL : \
+                       expected.member != NULL && result.member - result.scheme == expected.member - p_url)
+    if (result.scheme == NULL || strcmp(result.scheme, p_url) != 0 ||
+        !CHECK(colon_s) || !CHECK(slash) || !CHECK(userinfo) || !CHECK(atsymbol) || !CHECK(host) ||
+        !CHECK(colon_p) || !CHECK(port) || !CHECK(path) || !CHECK(question) || !CHECK(query) ||
+        !CHECK(pound) || !CHECK(fragment) || !CHECK(end) ||
+        URI_arena_used(p_arena) != used + strlen(p_url) + 1) {
+        printf("Failed URI into arena: %s\n", p_url);
+        printf("Output   - %s\n", result.scheme ? result.scheme : "NULL");
+        failures++;
+    }
+#undef CHECK
+    return result;
+}
+
+int main()
+{
+    static const char *urls[] = {
+        "http://example.com/a?b#c",
+        "https://www.example.com:8080/path/to/resource?key=value&other=1#section",
+        "mailto:user@example.com",
+        "urn:isbn:0451450523",
+        "http://[::1]:80/",
+        "file:///etc/hosts",
+        "not a URI",
+        "a:",
+    };
+    URI kept[64];
+    URI_arena arena;
+    URI_arena *mine = NULL;
+    char long_url[200];
+    size_t n = sizeof(urls) / sizeof(urls[0]);
+    size_t i = 0;
+
+    /* Small chunks, so URIs spill over into new ones and a long URI
+       needs a chunk of its own */
+    URI_arena_init(&arena, 32);
+    for (i = 0; i < 64; i++) {
+        kept[i] = test_parse(&arena, urls[i % n]);
+    }
+    memcpy(long_url, "http://example.com/", 19);
+    memset(long_url + 19, 'a', sizeof(long_url) - 20);
+    long_url[sizeof(long_url) - 1] = '\0';
+    test_parse(&arena, long_url);
+    test_parse(&arena, urls[0]);
+    /* Nothing parsed later moved or overwrote the earlier URIs */
+    for (i = 0; i < 64; i++) {
+        const char *url = urls[i % n];
+        if (parse_URI(url).scheme != NULL && (kept[i].scheme == NULL || strcmp(kept[i].scheme, url) != 0)) {
+            printf("Failed keeping URI in arena: %s\n", url);
+            failures++;
+        }
+    }
+
+    /* A reset reuses the same chunks from the start */
+    URI_arena_reset(&arena);
+    if (URI_arena_used(&arena) != 0) {
+        printf("Failed resetting arena\n");
+        failures++;
+    }
+    kept[0] = test_parse(&arena, urls[0]);
+    URI_arena_reset(&arena);
+    if (test_parse(&arena, urls[0]).scheme != kept[0].scheme) {
+        printf("Failed reusing chunk after reset\n");
+        failures++;
+    }
+    test_parse(&arena, long_url);
+
+    /* Freed, it can be used again */
+    URI_arena_free(&arena);
+    if (URI_arena_used(&arena) != 0 || arena.chunks != NULL) {
+        printf("Failed freeing arena\n");
+        failures++;
+    }
+    test_parse(&arena, urls[0]);
+    if (URI_arena_copy(&arena, "abc", 2) == NULL || strcmp(arena.next - 3, "ab") != 0) {
+        printf("Failed copying into arena\n");
+        failures++;
+    }
+    URI_arena_free(&arena);
+
+    /* The default chunk size, for each thread */
+    mine = URI_thread_arena();
+    if (mine != URI_thread_arena() || mine->chunk_size != URI_ARENA_CHUNK_SIZE) {
+        printf("Failed getting thread arena\n");
+        failures++;
+    }
+    for (i = 0; i < n; i++) {
+        test_parse(mine, urls[i]);
+    }
+    URI_arena_free(mine);
+
+    printf("Total failures: %d\n", failures);
+    return 0;
+}
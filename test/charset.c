@@ -0,0 +1,202 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "charset.h"
+#include "rfc_3986.h"
+#include "rfc_3966.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+/* Without the custom parser hooks only the built in charsets parse */
+#ifdef URI_NO_CUSTOM_CHARSET
+#define left_out(cs) ((cs) != NULL && (cs) != &charset_ascii && (cs) != &charset_utf8)
+#else
+#define left_out(cs) 0
+#endif
+
+/* Host is the expected host, or NULL if the URI shouldn't parse */
+void test_uri(const charset *cs, const char *uri, const char *host)
+{
+    URI result = parse_URI_charset(cs, uri);
+    char buf[256];
+    size_t len = sizeof(buf);
+
+    if (left_out(cs)) {
+        host = NULL;
+    }
+    if (host == NULL) {
+        if (result.scheme != NULL) {
+            printf("FAIL: %s parsed but shouldn't have\n", uri);
+            failures++;
+        }
+        return;
+    }
+    if (result.scheme == NULL) {
+        printf("FAIL: %s didn't parse\n", uri);
+        failures++;
+        return;
+    }
+    if (get_host(&result, buf, &len) == NULL || strcmp(buf, host) != 0) {
+        printf("FAIL: %s host was \"%.*s\", expected \"%s\"\n",
+               uri, (int)len_host(&result), result.host, host);
+        failures++;
+    }
+}
+
+/* Number is the expected global or local number, or NULL if it shouldn't parse */
+void test_tel(const charset *cs, const char *uri, const char *number)
+{
+    Tel result = parse_telephone_charset(cs, uri);
+    const char *start = result.global_number != NULL ? result.global_number : result.local_number;
+
+    if (left_out(cs)) {
+        number = NULL;
+    }
+    if (number == NULL) {
+        if (start != NULL) {
+            printf("FAIL: %s parsed but shouldn't have\n", uri);
+            failures++;
+        }
+        return;
+    }
+    if (start == NULL) {
+        printf("FAIL: %s didn't parse\n", uri);
+        failures++;
+        return;
+    }
+    if ((size_t)(result.number_stop - start) != strlen(number)
+        || memcmp(start, number, strlen(number)) != 0) {
+        printf("FAIL: %s number was \"%.*s\", expected \"%s\"\n",
+               uri, (int)(result.number_stop - start), start, number);
+        failures++;
+    }
+}
+
+/* Latin-1 letters, for a custom charset */
+static const char *parse_latin1_alpha(const char **s)
+{
+    unsigned char c = (unsigned char)**s;
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+        || (c >= 0xC0 && c != 0xD7 && c != 0xF7)) {
+        return (*s)++;
+    }
+    return NULL;
+}
+
+/* Arabic-Indic digits as well as ASCII, for a custom charset */
+static const char *parse_arabic_digit(const char **s)
+{
+    const unsigned char *p = (const unsigned char *)*s;
+    if (p[0] >= '0' && p[0] <= '9') {
+        return (*s)++;
+    }
+    if (p[0] == 0xD9 && p[1] >= 0xA0 && p[1] <= 0xA9) {
+        const char *start = *s;
+        *s += 2;
+        return start;
+    }
+    return NULL;
+}
+
+static const charset charset_latin1 = { parse_latin1_alpha, NULL };
+static const charset charset_arabic = { NULL, parse_arabic_digit };
+
+/* A custom parser that itself parses with another charset */
+static const char *parse_nested_alpha(const char **s)
+{
+    URI inner = parse_URI_charset(&charset_utf8, "http://\xe4\xbe\x8b/");
+    if (inner.scheme == NULL) {
+        return NULL;
+    }
+    return parse_latin1_alpha(s);
+}
+
+static const charset charset_nested = { parse_nested_alpha, NULL };
+
+/* Letters that take in "_" as well, which ASCII has as unreserved */
+static const char *parse_loose_alpha(const char **s)
+{
+    return **s == '_' ? (*s)++ : parse_latin1_alpha(s);
+}
+
+static const charset charset_loose = { parse_loose_alpha, NULL };
+
+int main()
+{
+    /* ASCII, whichever way it's asked for */
+    test_uri(NULL, "http://example.com/", "example.com");
+    test_uri(&charset_ascii, "http://example.com/", "example.com");
+    test_uri(&charset_utf8, "http://example.com/", "example.com");
+    test_uri(&charset_latin1, "http://example.com/", "example.com");
+    test_uri(NULL, "http://\xe4\xbe\x8b\xe5\xad\x90.\xe6\xb5\x8b\xe8\xaf\x95/", NULL);
+
+    /* UTF-8 */
+    test_uri(&charset_utf8, "http://\xe4\xbe\x8b\xe5\xad\x90.\xe6\xb5\x8b\xe8\xaf\x95/\xe4\xb8\xad\xe6\x96\x87",
+             "\xe4\xbe\x8b\xe5\xad\x90.\xe6\xb5\x8b\xe8\xaf\x95");
+    test_uri(&charset_utf8, "http://caf\xc3\xa9.fr/", "caf\xc3\xa9.fr");
+    test_uri(&charset_utf8, "http://\xf0\x9f\x98\x80.example/", "\xf0\x9f\x98\x80.example");
+    test_uri(&charset_utf8, "http://\x80.example/", NULL);             /* lone continuation */
+    test_uri(&charset_utf8, "http://\xc0\x80.example/", NULL);         /* overlong */
+    test_uri(&charset_utf8, "http://\xed\xa0\x80.example/", NULL);     /* surrogate */
+    test_uri(&charset_utf8, "http://\xf4\x90\x80\x80.example/", NULL); /* past U+10FFFF */
+    test_uri(&charset_utf8, "http://\xe4\xbe.example/", NULL);         /* truncated */
+    test_uri(&charset_utf8, "http://caf\xe9.fr/", NULL);
+
+    /* custom letters */
+    test_uri(&charset_latin1, "http://caf\xe9.fr/", "caf\xe9.fr");
+    test_uri(&charset_latin1, "http://caf\xc3\xa9.fr/", NULL);
+    test_uri(NULL, "http://caf\xe9.fr/", NULL);
+    test_uri(&charset_nested, "http://caf\xe9.fr/", "caf\xe9.fr");
+
+    /* what one custom charset matched says nothing about the next one */
+    test_uri(&charset_loose, "http://a_b/c_d", "a_b");
+    test_uri(&charset_latin1, "http://a_b/c_d", "a_b");
+
+    /* telephone */
+    test_tel(NULL, "tel:+1-201-555-0123", "+1-201-555-0123");
+    test_tel(&charset_utf8, "tel:+1-201-555-0123", "+1-201-555-0123");
+    test_tel(&charset_utf8, "tel:7042;phone-context=\xe4\xbe\x8b.example", "7042");
+    test_tel(NULL, "tel:7042;phone-context=\xe4\xbe\x8b.example", NULL);
+    test_tel(&charset_arabic, "tel:+\xd9\xa1-\xd9\xa2\xd9\xa0\xd9\xa1", "+\xd9\xa1-\xd9\xa2\xd9\xa0\xd9\xa1");
+    test_tel(NULL, "tel:+\xd9\xa1-\xd9\xa2\xd9\xa0\xd9\xa1", NULL);
+    test_tel(&charset_utf8, "tel:+\xd9\xa1-\xd9\xa2\xd9\xa0\xd9\xa1", NULL);
+
+    /* the custom charset is gone after the call */
+    test_uri(NULL, "http://caf\xe9.fr/", NULL);
+    test_tel(NULL, "tel:+\xd9\xa1", NULL);
+
+    printf("Total failures: %d\n", failures);
+    return 0;
+}
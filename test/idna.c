@@ -0,0 +1,150 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "idna.h"
+#include "rfc_3986.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+/* p_expected is NULL if the host can't be converted */
+void test_convert(char *(*convert)(const char *, size_t, char *, size_t *), const char *p_name,
+                  const char *p_host, const char *p_expected)
+{
+    char buf[256];
+    size_t len = sizeof(buf);
+    char *result = convert(p_host, strlen(p_host), buf, &len);
+    if (p_expected == NULL ? result != NULL || len != 0 :
+        result != buf || strcmp(buf, p_expected) != 0) {
+        printf("Failed %s for host: %s\n", p_name, p_host);
+        printf("Expected - %s\n", p_expected ? p_expected : "NULL");
+        printf("Output   - %s\n", result ? result : "NULL");
+        failures++;
+        return;
+    }
+    if (p_expected != NULL && *p_expected != '\0') {
+        /* one byte short, or a tiny buffer, gives the length */
+        size_t short_len = strlen(p_expected);
+        size_t tiny_len = 1;
+        if (convert(p_host, strlen(p_host), buf, &short_len) != NULL || short_len != strlen(p_expected) ||
+            convert(p_host, strlen(p_host), buf, &tiny_len) != NULL || tiny_len != strlen(p_expected)) {
+            printf("Failed %s for host: %s with a short buffer\n", p_name, p_host);
+            failures++;
+        }
+    }
+}
+
+/* Both ways between the two forms */
+void test_host(const char *p_unicode, const char *p_ascii)
+{
+    test_convert(host_to_ascii, "host_to_ascii", p_unicode, p_ascii);
+    test_convert(host_to_unicode, "host_to_unicode", p_ascii, p_unicode);
+    test_convert(host_to_ascii, "host_to_ascii", p_ascii, p_ascii);
+}
+
+void test_uri(URI (*parse)(const char *), const char *p_uri, const char *p_ascii, const char *p_unicode)
+{
+    URI uri = parse(p_uri);
+    char buf[256];
+    size_t len = sizeof(buf);
+    if (get_host_ascii(&uri, buf, &len) == NULL || strcmp(buf, p_ascii) != 0 ||
+        (len = sizeof(buf), get_host_unicode(&uri, buf, &len)) == NULL || strcmp(buf, p_unicode) != 0) {
+        printf("Failed for URI: %s\n", p_uri);
+        printf("Expected - %s, %s\n", p_ascii, p_unicode);
+        failures++;
+    }
+}
+
+int main()
+{
+    /* plain hosts are the same both ways */
+    test_host("example.com", "example.com");
+    test_host("www.a-very-long-host-name-to-cross-sixteen-bytes.example.com",
+              "www.a-very-long-host-name-to-cross-sixteen-bytes.example.com");
+    test_host("a--b.example", "a--b.example");
+    test_host("", "");
+    test_host("127.0.0.1", "127.0.0.1");
+
+    /* RFC 3492 and well known labels */
+    test_host("b\xc3\xbc" "cher.example", "xn--bcher-kva.example");
+    test_host("www.m\xc3\xbc" "nchen.de", "www.xn--mnchen-3ya.de");
+    test_host("\xe4\xbe\x8b\xe5\xad\x90.\xe6\xb5\x8b\xe8\xaf\x95", "xn--fsqu00a.xn--0zwm56d");
+    test_host("\xd0\xbf\xd1\x80\xd0\xb8\xd0\xbc\xd0\xb5\xd1\x80.\xd1\x80\xd1\x84", "xn--e1afmkfd.xn--p1ai");
+    test_host("\xe2\x98\x83.net", "xn--n3h.net");
+    test_host("\xf0\x9f\x98\x80.example", "xn--e28h.example");
+    test_host("caf\xc3\xa9", "xn--caf-dma");
+    test_host("3\xe5\xb9\xb4" "B\xe7\xb5\x84\xe9\x87\x91\xe5\x85\xab\xe5\x85\x88\xe7\x94\x9f",
+              "xn--3B-ww4c5e180e575a65lsy2b");
+    test_host("a.\xe2\x98\x83.b.\xe2\x98\x83", "a.xn--n3h.b.xn--n3h");
+
+    /* pct-encoded UTF-8, as IRI_to_URI writes it */
+    test_convert(host_to_ascii, "host_to_ascii", "caf%C3%A9.fr", "xn--caf-dma.fr");
+    test_convert(host_to_ascii, "host_to_ascii", "ex%61mple.com", "example.com");
+    test_convert(host_to_ascii, "host_to_ascii", "b\xc3\xbc%2Dx", "xn--b-x-hoa");
+    /* the prefix and digits are case insensitive */
+    test_convert(host_to_unicode, "host_to_unicode", "XN--caf-DMA.fr", "caf\xc3\xa9.fr");
+
+    /* invalid */
+    test_convert(host_to_ascii, "host_to_ascii", "caf\xc3.fr", NULL);
+    test_convert(host_to_ascii, "host_to_ascii", "caf\xed\xa0\x80.fr", NULL);
+    test_convert(host_to_ascii, "host_to_ascii", "caf%C3.fr", NULL);
+    /* * pct-encoded ASCII that can't be in a label */
+    test_convert(host_to_ascii, "host_to_ascii", "b\xc3\xbc%2Fx", NULL);
+    test_convert(host_to_ascii, "host_to_ascii", "b\xc3\xbc%40x", NULL);
+    test_convert(host_to_ascii, "host_to_ascii", "b\xc3\xbc%20x", NULL);
+    test_convert(host_to_ascii, "host_to_ascii", "b\xc3\xbc%2Ede", NULL);
+    test_convert(host_to_ascii, "host_to_ascii", "b\xc3\xbc%00x", NULL);
+    test_convert(host_to_ascii, "host_to_ascii", "b%C3%BC%2fx.de", NULL);
+    test_convert(host_to_ascii, "host_to_ascii", "ex%2Eample.com", NULL);
+    test_convert(host_to_ascii, "host_to_ascii", "b\xc3\xbc_x", NULL);
+    test_convert(host_to_ascii, "host_to_ascii",
+                 "abcdefghijabcdefghijabcdefghijabcdefghijabcdefghijabcdefghijab\xc3\xa9.com", NULL);
+    test_convert(host_to_unicode, "host_to_unicode", "xn--.com", NULL);
+    test_convert(host_to_unicode, "host_to_unicode", "xn--abc-.com", NULL);
+    test_convert(host_to_unicode, "host_to_unicode", "xn--caf-dm!.com", NULL);
+    test_convert(host_to_unicode, "host_to_unicode", "xn--99999999999.com", NULL);
+    test_convert(host_to_unicode, "host_to_unicode", "xn--\xc3\xa9-dma.com", NULL);
+
+    /* from parsed URIs */
+    test_uri(parse_URI, "http://xn--fsqu00a.xn--0zwm56d/", "xn--fsqu00a.xn--0zwm56d",
+             "\xe4\xbe\x8b\xe5\xad\x90.\xe6\xb5\x8b\xe8\xaf\x95");
+    test_uri(parse_IRI, "http://\xe4\xbe\x8b\xe5\xad\x90.\xe6\xb5\x8b\xe8\xaf\x95/", "xn--fsqu00a.xn--0zwm56d",
+             "\xe4\xbe\x8b\xe5\xad\x90.\xe6\xb5\x8b\xe8\xaf\x95");
+#ifndef URI_NO_USERINFO
+    test_uri(parse_URI, "http://user@example.com:80/", "example.com", "example.com");
+#endif
+
+    printf("Total failures: %d\n", failures);
+    return 0;
+}
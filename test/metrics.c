@@ -0,0 +1,173 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rfc_3986.h"
+#include "metrics.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+static metrics_snapshot before;
+static metrics_snapshot after;
+
+#define ASSERT(e) do { if (!(e)) { printf("Assert failed on line %d. Expected: %s\n", __LINE__, #e); failures++; } } while(0)
+
+static unsigned long successes(const metrics_snapshot *m, metrics_scheme scheme)
+{
+    unsigned long total = 0;
+    unsigned int i = 0;
+    for (i = 0; i < METRICS_LENGTHS; i++) {
+        total += m->successes[scheme][i];
+    }
+    return total;
+}
+
+static unsigned long latencies(const metrics_snapshot *m, metrics_scheme scheme, unsigned int length)
+{
+    unsigned long total = 0;
+    unsigned int i = 0;
+    for (i = 0; i < METRICS_BINS; i++) {
+        total += m->latency[scheme][length][i];
+    }
+    return total;
+}
+
+#define PARSES_PER_THREAD 100
+
+static void *parse_some(void *arg)
+{
+    unsigned int i = 0;
+    (void)arg;
+    for (i = 0; i < PARSES_PER_THREAD; i++) {
+        parse_URI("ws://example.com/");
+    }
+    return NULL;
+}
+
+/* Run threads one after another, each parsing and exiting, then as many
+ * at once, which is more than get slots of their own */
+static void run_threads(unsigned int count)
+{
+    pthread_t threads[64];
+    unsigned int i = 0;
+    for (i = 0; i < count; i++) {
+        ASSERT(pthread_create(&threads[0], NULL, parse_some, NULL) == 0);
+        pthread_join(threads[0], NULL);
+    }
+    for (i = 0; i < 64; i++) {
+        ASSERT(pthread_create(&threads[i], NULL, parse_some, NULL) == 0);
+    }
+    for (i = 0; i < 64; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+#define FAILURES(scheme, reason) \
+    (after.failures[scheme][reason] - before.failures[scheme][reason])
+
+int main()
+{
+    unsigned int i = 0;
+
+    /* Nothing is recorded until enabled */
+    parse_URI("http://example.com/");
+    metrics_snapshot_take(&after);
+    ASSERT(successes(&after, METRICS_HTTP) == 0);
+
+    metrics_enable(1);
+    metrics_snapshot_take(&before);
+    ASSERT(parse_URI("http://example.com/").scheme != NULL);
+    ASSERT(parse_URI("HTTPS://example.com/").scheme != NULL);
+    ASSERT(parse_URI("https://example.com/index.html?q=1").scheme != NULL);
+    ASSERT(parse_URI("gopher://example.com/").scheme != NULL);
+    ASSERT(parse_URI("urn:isbn:0451450523").scheme != NULL);
+    ASSERT(parse_URI("1http://example.com/").scheme == NULL);
+    ASSERT(parse_URI("http//example.com/").scheme == NULL);
+    ASSERT(parse_URI("http://exa mple.com/").scheme == NULL);
+    ASSERT(parse_URI("http://example.com/a b").scheme == NULL);
+    ASSERT(parse_URI("http://example.com/?a b").scheme == NULL);
+    ASSERT(parse_URI("ftp://example.com/#a#b").scheme == NULL);
+    metrics_snapshot_take(&after);
+    metrics_enable(0);
+
+    ASSERT(successes(&after, METRICS_HTTP) - successes(&before, METRICS_HTTP) == 1);
+    ASSERT(successes(&after, METRICS_HTTPS) - successes(&before, METRICS_HTTPS) == 2);
+    ASSERT(successes(&after, METRICS_OTHER) - successes(&before, METRICS_OTHER) == 1);
+    ASSERT(successes(&after, METRICS_URN) - successes(&before, METRICS_URN) == 1);
+    ASSERT(FAILURES(METRICS_OTHER, METRICS_FAIL_SCHEME) == 1);
+    ASSERT(FAILURES(METRICS_OTHER, METRICS_FAIL_COLON) == 1);
+    ASSERT(FAILURES(METRICS_HTTP, METRICS_FAIL_AUTHORITY) == 1);
+    ASSERT(FAILURES(METRICS_HTTP, METRICS_FAIL_PATH) == 1);
+    ASSERT(FAILURES(METRICS_HTTP, METRICS_FAIL_QUERY) == 1);
+    ASSERT(FAILURES(METRICS_FTP, METRICS_FAIL_FRAGMENT) == 1);
+
+    /* Every parse lands in a histogram, keyed by the length read,
+       which for "http://exa mple.com/" is under 16 characters */
+    ASSERT(latencies(&after, METRICS_HTTP, 0) - latencies(&before, METRICS_HTTP, 0) == 1);
+    ASSERT(latencies(&after, METRICS_HTTP, 1) - latencies(&before, METRICS_HTTP, 1) == 3);
+    ASSERT(latencies(&after, METRICS_HTTPS, 2) - latencies(&before, METRICS_HTTPS, 2) == 1);
+
+    /* Nor once disabled again */
+    parse_URI("http://example.com/");
+    metrics_snapshot_take(&before);
+    ASSERT(memcmp(&before, &after, sizeof(before)) == 0);
+
+    /* Slots given back by threads that exit are taken again, and the
+       counts of every thread, sharing a slot or not, are all kept */
+    metrics_enable(1);
+    metrics_snapshot_take(&before);
+    run_threads(100);
+    metrics_snapshot_take(&after);
+    metrics_enable(0);
+    ASSERT(successes(&after, METRICS_WS) - successes(&before, METRICS_WS) == (100 + 64) * PARSES_PER_THREAD);
+
+    /* Labels */
+    ASSERT(strcmp(metrics_scheme_name(METRICS_HTTPS), "https") == 0);
+    ASSERT(strcmp(metrics_reason_name(METRICS_FAIL_PATH), "path") == 0);
+    ASSERT(metrics_scheme_name(METRICS_SCHEMES) == NULL);
+    ASSERT(metrics_length_upper(0) == 16);
+    ASSERT(metrics_length_upper(METRICS_LENGTHS - 1) == (size_t)-1);
+    ASSERT(metrics_bin_upper(0) == 64);
+    ASSERT(metrics_bin_upper(1) == 80);
+    ASSERT(metrics_bin_upper(4) == 128);
+    ASSERT(metrics_bin_upper(5) == 160);
+    ASSERT(metrics_bin_upper(METRICS_BINS - 1) == ~0ULL);
+    for (i = 1; i < METRICS_BINS; i++) {
+        ASSERT(metrics_bin_upper(i) > metrics_bin_upper(i - 1));
+    }
+
+    printf("Total failures: %d\n", failures);
+    return 0;
+}
@@ -0,0 +1,73 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef URI_PATH_FINDER_TEST_PIECES_H
+#define URI_PATH_FINDER_TEST_PIECES_H
+
+#include <stddef.h>
+#include <string.h>
+
+/* Random strings for the tests that compare two ways of parsing, made
+ * of pieces of the syntax so most get some way in before they're
+ * invalid.  The generator is a plain LCG so every run sees the same
+ * strings. */
+
+#define PIECES(pieces) (pieces), (sizeof(pieces) / sizeof(*(pieces)))
+
+static unsigned int pieces_rand(unsigned int *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 16;
+}
+
+static const char *pieces_pick(unsigned int *seed, const char *const *pieces, size_t count)
+{
+    return pieces[pieces_rand(seed) % count];
+}
+
+/* prefix followed by 1 to most random pieces, as many as fit in size */
+static char *pieces_join(unsigned int *seed, char *buf, size_t size, const char *prefix,
+                         const char *const *pieces, size_t count, int most)
+{
+    int n = 0;
+    strcpy(buf, prefix);
+    for (n = pieces_rand(seed) % most; n >= 0; n--) {
+        const char *piece = pieces_pick(seed, pieces, count);
+        if (strlen(buf) + strlen(piece) < size) {
+            strcat(buf, piece);
+        }
+    }
+    return buf;
+}
+
+#endif /* URI_PATH_FINDER_TEST_PIECES_H */
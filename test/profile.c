@@ -0,0 +1,123 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rfc_3986.h"
+#include "profile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define ASSERT(e) do { if (!(e)) { printf("Assert failed on line %d. Expected: %s\n", __LINE__, #e); failures++; } } while(0)
+
+/* The combined counts for a rule, or -1 for calls if it never ran */
+static void find(const char *name, long *calls, long *successes, long *rewound)
+{
+    const profile_rule *r = NULL;
+    *calls = -1;
+    *successes = 0;
+    *rewound = 0;
+    for (r = profile_rules(); r != NULL; r = r->next) {
+        if (strcmp(r->name, name) == 0) {
+            *calls = (*calls < 0 ? 0 : *calls) + r->successes + r->failures;
+            *successes += r->successes;
+            *rewound += r->rewound;
+        }
+    }
+}
+
+int main()
+{
+    long calls = 0;
+    long successes = 0;
+    long rewound = 0;
+
+    ASSERT(parse_URI("http://example.com/a?b#c").scheme != NULL);
+#ifndef URI_NO_IPV6
+    ASSERT(parse_URI("http://[::1]/").scheme != NULL);
+#else
+    /* IPv6 literals are left out of the grammar */
+    ASSERT(parse_URI("http://[::1]/").scheme == NULL);
+#endif
+    ASSERT(parse_URI("http://example.com/ a").scheme == NULL);
+
+#ifdef URI_PROFILE
+    find("parse_URI", &calls, &successes, &rewound);
+    ASSERT(calls == 3);
+#ifndef URI_NO_IPV6
+    ASSERT(successes == 2);
+    /* "::1" is the eighth IPv6 case, the ones before match it in part */
+    find("parse_IPv6address_case_8", &calls, &successes, &rewound);
+    ASSERT(calls == 1);
+    ASSERT(successes == 1);
+    find("parse_IPv6address_case_7", &calls, &successes, &rewound);
+    ASSERT(calls == 1);
+    ASSERT(successes == 0);
+    ASSERT(rewound == 2);
+    find("parse_IPv6address_case_9", &calls, &successes, &rewound);
+    ASSERT(calls == -1);
+#else
+    ASSERT(successes == 1);
+#endif
+    /* Combinators are counted over every file that uses them */
+    find("parse_opt", &calls, &successes, &rewound);
+#if defined(URI_ADAPTIVE) && defined(URI_NO_IPV6) && defined(URI_NO_IPVFUTURE)
+    /* The only alternatives left are disjoint, so they're all cached */
+    find("parse_opt_cached", &calls, &successes, &rewound);
+#endif
+    ASSERT(calls > 0);
+    ASSERT(successes > 0 && successes < calls);
+
+    profile_reset();
+    find("parse_URI", &calls, &successes, &rewound);
+    ASSERT(calls == 0);
+    ASSERT(parse_URI("urn:isbn:0451450523").scheme != NULL);
+    find("parse_URI", &calls, &successes, &rewound);
+    ASSERT(calls == 1);
+    ASSERT(successes == 1);
+#ifndef URI_NO_IPV6
+    find("parse_IPv6address", &calls, &successes, &rewound);
+    ASSERT(calls == 0);
+#endif
+#else
+    /* Nothing is counted unless built with URI_PROFILE */
+    ASSERT(profile_rules() == NULL);
+    (void)calls;
+    (void)successes;
+    (void)rewound;
+    (void)find;
+#endif
+
+    printf("Total failures: %d\n", failures);
+    return 0;
+}
@@ -31,6 +31,8 @@
  */
 
 #include "rfc_3966.h"
+#include "metrics.h"
+#include "pieces.h"
 
 #include <stdio.h>
 #include <stddef.h>
@@ -38,6 +40,87 @@
 
 static int failures = 0;
 
+/* is_valid_telephone has to agree with parse_telephone on the string
+ * and on each of its prefixes, which aren't NULL terminated */
+void test_valid(char *p_url)
+{
+    char prefix[256];
+    size_t len = strlen(p_url);
+    size_t i = 0;
+    for (i = 0; i <= len && i < sizeof(prefix); i++) {
+        Tel result;
+        int expected = 0;
+        memcpy(prefix, p_url, i);
+        prefix[i] = '\0';
+        result = parse_telephone(prefix);
+        expected = result.global_number != NULL || result.local_number != NULL;
+        if (is_valid_telephone(p_url, i) != expected) {
+            printf("Failed validating URI: %.*s\n", (int)i, p_url);
+            printf("Expected - valid: %d\n", expected);
+            failures++;
+            return;
+        }
+    }
+}
+
+/* is_valid_telephone has to agree with parse_telephone on a tel URI
+ * longer than any buffer, p_prefix followed by p_count of p_fill and
+ * then p_suffix */
+void test_valid_long(char *p_prefix, size_t p_count, char p_fill, char *p_suffix, int p_valid)
+{
+    static char url[4096];
+    size_t len = strlen(p_prefix);
+    Tel result;
+    memcpy(url, p_prefix, len);
+    memset(url + len, p_fill, p_count);
+    strcpy(url + len + p_count, p_suffix);
+    result = parse_telephone(url);
+    if ((result.global_number != NULL || result.local_number != NULL) != p_valid ||
+        is_valid_telephone(url, strlen(url)) != p_valid) {
+        printf("Failed validating long URI: %s ...%s\n", p_prefix, p_suffix);
+        printf("Expected - valid: %d\n", p_valid);
+        failures++;
+    }
+}
+
+#ifdef RFC_3966_CHECK_ORDER
+/* Whether the parameters break the order RFC 3966 gives, which only
+ * fails the parse when the order is checked.  This walks the
+ * parameters on its own so it doesn't share a bug with the parser. */
+static int out_of_order(const char *p_url)
+{
+    const char *p = strchr(p_url, ';');
+    const char *prev = NULL;
+    size_t prev_len = 0;
+    int prev_rank = 0;
+    while (p != NULL) {
+        const char *name = p + 1;
+        size_t len = strcspn(name, "=;");
+        int rank = (len == 3 && strncmp(name, "ext", 3) == 0) ||
+                   (len == 4 && strncmp(name, "isub", 4) == 0) ? 0 :
+                   (len == 13 && strncmp(name, "phone-context", 13) == 0) ? 1 : 2;
+        if (rank < prev_rank) {
+            return 1;
+        }
+        if (rank == 2 && prev != NULL) {
+            int cmp = strncmp(prev, name, prev_len < len ? prev_len : len);
+            if (cmp > 0 || (cmp == 0 && prev_len > len)) {
+                return 1;
+            }
+        }
+        if (rank == 2) {
+            prev = name;
+            prev_len = len;
+        }
+        prev_rank = rank;
+        p = strchr(name, ';');
+    }
+    return 0;
+}
+#else
+#define out_of_order(p_url) 0
+#endif /* RFC_3966_CHECK_ORDER */
+
 #define NULL_CHECK_P(id) (result.pars.id && !p_##id) || (!result.pars.id && p_##id)
 #define BAD_LEN_CHECK_P(id, len) result.pars.id && len != (int)strlen(p_##id)
 #define BAD_COMPARE_P(id) result.pars.id && strncmp(result.pars.id, p_##id, strlen(p_##id))
@@ -56,6 +139,11 @@ void test_tel(char *p_url, char *p_global_number, char *p_local_number, char *p_
     int pars_2_len  = len_par_pars_2(&result);
     int pars_3_len  = len_par_pars_3(&result);
     int pars_4_len  = len_par_pars_4(&result);
+    if (out_of_order(p_url)) {
+        p_global_number = p_local_number = NULL;
+        p_ext = p_isdn = p_context = NULL;
+        p_pars_1 = p_pars_2 = p_pars_3 = p_pars_4 = NULL;
+    }
     if (NULL_CHECK(global_number) || BAD_LEN_CHECK(global_number, global_len) || BAD_COMPARE(global_number) ||
         NULL_CHECK(local_number)  || BAD_LEN_CHECK(local_number, local_len)  || BAD_COMPARE(local_number)  ||
         NULL_CHECK_P(ext)         || BAD_LEN_CHECK_P(ext,     ext_len)        || BAD_COMPARE_P(ext)         ||
@@ -88,6 +176,182 @@ void test_tel(char *p_url, char *p_global_number, char *p_local_number, char *p_
                result.pars.pars_4   ? pars_4_len  : 4, result.pars.pars_4   ? result.pars.pars_4   : "NULL");
         failures++;
     }
+    test_valid(p_url);
+}
+
+void test_np(char *p_url, char *p_npdi, char *p_rn, char *p_cic, char *p_pars_1)
+{
+    Tel result = parse_telephone(p_url);
+    int npdi_len   = len_par_npdi(&result);
+    int rn_len     = len_par_rn(&result);
+    int cic_len    = len_par_cic(&result);
+    int pars_1_len = len_par_pars_1(&result);
+    if (out_of_order(p_url)) {
+        p_npdi = p_rn = p_cic = p_pars_1 = NULL;
+    }
+    if (NULL_CHECK_P(npdi)   || BAD_LEN_CHECK_P(npdi,   npdi_len)   || BAD_COMPARE_P(npdi)   ||
+        NULL_CHECK_P(rn)     || BAD_LEN_CHECK_P(rn,     rn_len)     || BAD_COMPARE_P(rn)     ||
+        NULL_CHECK_P(cic)    || BAD_LEN_CHECK_P(cic,    cic_len)    || BAD_COMPARE_P(cic)    ||
+        NULL_CHECK_P(pars_1) || BAD_LEN_CHECK_P(pars_1, pars_1_len) || BAD_COMPARE_P(pars_1)) {
+        printf("Failed for URI: %s\n", p_url);
+        printf("Expected - npdi: %s, rn: %s, cic: %s, pars_1: %s\n",
+               p_npdi ? p_npdi : "NULL",
+               p_rn ? p_rn : "NULL",
+               p_cic ? p_cic : "NULL",
+               p_pars_1 ? p_pars_1 : "NULL");
+        printf("Output   - npdi: %.*s, rn: %.*s, cic: %.*s, pars_1: %.*s\n",
+               result.pars.npdi   ? npdi_len   : 4, result.pars.npdi   ? result.pars.npdi   : "NULL",
+               result.pars.rn     ? rn_len     : 4, result.pars.rn     ? result.pars.rn     : "NULL",
+               result.pars.cic    ? cic_len    : 4, result.pars.cic    ? result.pars.cic    : "NULL",
+               result.pars.pars_1 ? pars_1_len : 4, result.pars.pars_1 ? result.pars.pars_1 : "NULL");
+        failures++;
+    }
+    test_valid(p_url);
+}
+
+/* Each special parameter splits the regular ones into another run,
+ * which get_pars joins back together */
+void test_runs(char *p_url, char *p_pars, char *p_pars_7)
+{
+    Tel result = parse_telephone(p_url);
+    char buf[256];
+    size_t len = sizeof(buf);
+    char *pars = get_pars(&result, buf, &len);
+    int pars_7_len = len_par_pars_7(&result);
+    if (out_of_order(p_url)) {
+        p_pars = p_pars_7 = NULL;
+    }
+    if ((p_pars == NULL ? pars != NULL || len_pars(&result) != 0 :
+         pars == NULL || strcmp(pars, p_pars) != 0 || len_pars(&result) != strlen(p_pars)) ||
+        NULL_CHECK_P(pars_7) || BAD_LEN_CHECK_P(pars_7, pars_7_len) || BAD_COMPARE_P(pars_7)) {
+        printf("Failed for URI: %s\n", p_url);
+        printf("Expected - pars: %s, pars_7: %s\n", p_pars ? p_pars : "NULL", p_pars_7 ? p_pars_7 : "NULL");
+        printf("Output   - pars: %s, pars_7: %.*s\n", pars ? pars : "NULL",
+               result.pars.pars_7 ? pars_7_len : 4, result.pars.pars_7 ? result.pars.pars_7 : "NULL");
+        failures++;
+    }
+    test_valid(p_url);
+}
+
+void test_equal(char *p_lhs, char *p_rhs, int p_equal)
+{
+    Tel lhs = parse_telephone(p_lhs);
+    Tel rhs = parse_telephone(p_rhs);
+    if (out_of_order(p_lhs) || out_of_order(p_rhs)) {
+        return;
+    }
+    int equal = tel_equal(&lhs, &rhs);
+    if (equal != p_equal || equal != tel_equal(&rhs, &lhs) ||
+        (equal && tel_hash(&lhs) != tel_hash(&rhs))) {
+        printf("Failed for URIs: %s and %s\n", p_lhs, p_rhs);
+        printf("Expected - equal: %d\n", p_equal);
+        printf("Output   - equal: %d, reversed: %d, hashes: %lu %lu\n",
+               equal, tel_equal(&rhs, &lhs),
+               (unsigned long)tel_hash(&lhs), (unsigned long)tel_hash(&rhs));
+        failures++;
+    }
+}
+
+/* Compare is_valid_telephone and parse_telephone on strings made of
+ * pieces of tel URIs, most of which are invalid somewhere */
+void test_valid_random(int count)
+{
+    static const char *pieces[] = {
+        "tel:", "tel:+", "+", "1", "555", "-", ".", "(", ")", "*", "#", "A",
+        ";", "ext=", "isub=", "phone-context=", "example.com", "+1-800", "npdi",
+        "rn=", "cic=", "=", "x", "%20", "%", "[a]", " ", "\x80", "|",
+        "0123456789012345678"
+    };
+    unsigned int seed = 1;
+    char url[256];
+    int i = 0;
+    for (i = 0; i < count; i++) {
+        test_valid(pieces_join(&seed, url, sizeof(url), "tel:", PIECES(pieces), 12));
+    }
+}
+
+/* Record the events of parse_telephone_events as text to compare */
+static void log_event(void *ctx, const char *kind, const char *start, size_t len)
+{
+    char *log = ctx;
+    size_t used = strlen(log);
+    sprintf(log + used, "%s%s=%.*s", used ? " " : "", kind, (int)len, start);
+}
+
+static void on_number(void *ctx, const char *start, size_t len)
+{
+    log_event(ctx, "number", start, len);
+}
+
+static void on_parameter(void *ctx, const char *name, size_t name_len, const char *value, size_t value_len)
+{
+    log_event(ctx, "name", name, name_len);
+    if (value != NULL) {
+        log_event(ctx, "value", value, value_len);
+    }
+}
+
+void test_events(char *p_url, char *p_events)
+{
+    static const Tel_handler handler = { on_number, on_parameter };
+    char events[512] = "";
+    Tel result = parse_telephone_events(p_url, &handler, events);
+    Tel expected = parse_telephone(p_url);
+    if (memcmp(&result, &expected, sizeof(Tel)) != 0 ||
+        (!out_of_order(p_url) && strcmp(events, p_events != NULL ? p_events : "") != 0)) {
+        printf("Failed for URI: %s\n", p_url);
+        printf("Expected - %s\n", p_events ? p_events : "");
+        printf("Output   - %s\n", events);
+        failures++;
+    }
+}
+
+static metrics_snapshot before;
+static metrics_snapshot after;
+
+void test_error(char *p_url, int p_offset, char *p_component)
+{
+    Tel_error error = { 0, NULL };
+    Tel result = parse_telephone_error(p_url, &error);
+    int valid = result.global_number != NULL || result.local_number != NULL;
+    if (out_of_order(p_url)) {
+        /* Which parameter is blamed depends on the order */
+        p_component = "parameters";
+        p_offset = error.offset;
+    }
+    if ((p_component == NULL && (!valid || error.component != NULL)) ||
+        (p_component != NULL && (valid || error.component == NULL ||
+                                 (int)error.offset != p_offset ||
+                                 strcmp(error.component, p_component) != 0))) {
+        printf("Failed for URI: %s\n", p_url);
+        printf("Expected - offset: %d, component: %s\n", p_offset, p_component ? p_component : "NULL");
+        printf("Output   - offset: %d, component: %s\n", (int)error.offset, error.component ? error.component : "NULL");
+        failures++;
+    }
+}
+
+/* Check that parsing with metrics enabled counts the expected reason,
+ * or a success if it is -1. */
+void test_reason(char *p_url, int p_reason)
+{
+    unsigned long counted = 0;
+    unsigned long expected = 0;
+    int i = 0;
+    metrics_snapshot_take(&before);
+    parse_telephone(p_url);
+    metrics_snapshot_take(&after);
+    for (i = 0; i < METRICS_REASONS; i++) {
+        counted += after.failures[METRICS_TEL][i] - before.failures[METRICS_TEL][i];
+    }
+    for (i = 0; i < METRICS_LENGTHS; i++) {
+        counted += after.successes[METRICS_TEL][i] - before.successes[METRICS_TEL][i];
+    }
+    expected = p_reason < 0 ? 0 : after.failures[METRICS_TEL][p_reason] - before.failures[METRICS_TEL][p_reason];
+    if (counted != 1 || (p_reason >= 0 && expected != 1)) {
+        printf("Failed for URI: %s\n", p_url);
+        printf("Expected - reason: %s\n", p_reason < 0 ? "none" : metrics_reason_name(p_reason));
+        failures++;
+    }
 }
 
 int main()
@@ -108,6 +372,7 @@ int main()
     test_tel("tel:+14155552671;isub=abcd;custom1=123;ext=001;custom2=xyz", "+14155552671", NULL, ";ext=001", ";isub=abcd", NULL, ";custom1=123", ";custom2=xyz", NULL, NULL);
     test_tel("tel:+1234567890;foo=bar;isub=100;ext=555", "+1234567890", NULL, ";ext=555", ";isub=100", NULL, ";foo=bar", NULL, NULL, NULL);
     test_tel("tel:5551234567;phone-context=local;param1=val1;param2=val2", NULL, "5551234567", NULL, NULL, ";phone-context=local", ";param1=val1;param2=val2", NULL, NULL, NULL);
+    test_tel("tel:5551234567;isub=9;ext=1;phone-context=local;a;b=1;ba", NULL, "5551234567", ";ext=1", ";isub=9", ";phone-context=local", ";a;b=1;ba", NULL, NULL, NULL);
     test_tel("tel:5551234567;foo=bar;ext=123;isub=9999;phone-context=example.com", NULL, "5551234567", ";ext=123", ";isub=9999", ";phone-context=example.com", ";foo=bar", NULL, NULL, NULL);
     test_tel("tel:555-1111;phone-context=+44;param=abc;ext=12", NULL, "555-1111", ";ext=12", NULL, ";phone-context=+44", ";param=abc", NULL, NULL, NULL);
     test_tel("tel:+1-800-555-0199", "+1-800-555-0199", NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
@@ -159,6 +424,110 @@ int main()
     /* * parameter values can't start with spaces */
     test_tel("tel:+5551234567;foo= bar;isub=9999", NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
 
+    /* Number portability and carrier parameters (RFC 4694) */
+    test_np("tel:+1-202-533-1234;npdi;rn=+1-202-544-0000", ";npdi", ";rn=+1-202-544-0000", NULL, NULL);
+    test_np("tel:+1-202-533-1234;cic=+1-6789", NULL, NULL, ";cic=+1-6789", NULL);
+    test_np("tel:+1-202-533-1234;npdi;rn=+1-202-544-0000;cic=+1-6789;foo=bar", ";npdi", ";rn=+1-202-544-0000", ";cic=+1-6789", ";foo=bar");
+    test_np("tel:+1-202-533-1234;rn=2025440000;rn-context=+1", NULL, ";rn=2025440000", NULL, ";rn-context=+1");
+    test_np("tel:+1-202-533-1234;cic=6789;cic-context=example.com", NULL, NULL, ";cic=6789", ";cic-context=example.com");
+    test_np("tel:+1-202-533-1234;rn=+1-AB-CD", NULL, ";rn=+1-AB-CD", NULL, NULL);
+    /* * these only look like them */
+    test_np("tel:+1-202-533-1234;npdix=1", NULL, NULL, NULL, ";npdix=1");
+    test_np("tel:+1-202-533-1234;npdi=yes", NULL, NULL, NULL, ";npdi=yes");
+    test_np("tel:+1-202-533-1234;extrn=5", NULL, NULL, NULL, ";extrn=5");
+    test_np("tel:+1-202-533-1234;rn=+12345", NULL, ";rn=+12345", NULL, NULL);
+    test_np("tel:+1-202-533-1234;rn=+1234x", NULL, NULL, NULL, NULL);
+    test_np("tel:+1-202-533-1234;rn=+abc", NULL, NULL, NULL, ";rn=+abc");
+    test_np("tel:+1-202-533-1234;cic=zzz", NULL, NULL, NULL, ";cic=zzz");
+    /* * each may only appear once */
+    test_np("tel:+1-202-533-1234;npdi;npdi", NULL, NULL, NULL, NULL);
+    test_np("tel:+1-202-533-1234;rn=+1;rn=+2", NULL, NULL, NULL, NULL);
+    /* * regular parameters between all six special ones */
+    test_np("tel:+1;a;ext=1;b;isub=x;c;npdi;d;rn=5;e", ";npdi", ";rn=5", NULL, ";a");
+    test_np("tel:+1;a;npdi;b;rn=5;c;cic=6;d;ext=1;e", ";npdi", ";rn=5", ";cic=6", ";a");
+    test_runs("tel:+1;a;ext=1;b;isub=x;c;npdi;d;rn=5;e", ";a;b;c;d;e", NULL);
+    test_runs("tel:+1;a;npdi;b;rn=5;c;cic=6;d;ext=1;e", ";a;b;c;d;e", NULL);
+    test_runs("tel:7042;a;ext=1;b;isub=x;c;phone-context=+1;d;npdi;e;rn=5;f;cic=6;g",
+              ";a;b;c;d;e;f;g", ";g");
+    test_runs("tel:7042;a=1;b=2;ext=1;c;isub=x;phone-context=+1;npdi;d;rn=5;cic=6;e;f=3",
+              ";a=1;b=2;c;d;e;f=3", NULL);
+    test_runs("tel:+1;ext=1;isub=x;npdi;rn=5;cic=6", NULL, NULL);
+    test_runs("tel:+1", NULL, NULL);
+
+    /* Equivalence */
+    test_equal("tel:+1234567890", "tel:+1234567890", 1);
+    test_equal("tel:+1-234-567-890", "tel:+1(234)567.890", 1);
+    test_equal("tel:+1234567890", "tel:+1234567891", 0);
+    test_equal("tel:+1234567890", "tel:+12345678900", 0);
+    test_equal("tel:7042;phone-context=example.com", "tel:7042;phone-context=EXAMPLE.com", 1);
+    test_equal("tel:7042;phone-context=example.com", "tel:7042;phone-context=example.org", 0);
+    test_equal("tel:863-1234;phone-context=+1-914-555", "tel:8631234;phone-context=+1914555", 1);
+    test_equal("tel:863-1234;phone-context=+1-914-555", "tel:8631234;phone-context=+1914556", 0);
+    test_equal("tel:abc-1234;phone-context=example.com", "tel:ABC1234;phone-context=example.com", 1);
+    test_equal("tel:+1234567890;ext=1-2-3", "tel:+1234567890;ext=123", 1);
+    test_equal("tel:+1234567890;ext=123", "tel:+1234567890;ext=124", 0);
+    test_equal("tel:+1234567890;ext=123;foo=bar", "tel:+1234567890;FOO=BAR;ext=123", 1);
+    test_equal("tel:+1234567890;isub=5678;ext=2345;x=1;y=2", "tel:+1234567890;y=2;ext=2345;x=1;isub=5678", 1);
+    test_equal("tel:+1234567890;foo=bar", "tel:+1234567890", 0);
+    test_equal("tel:+1-201-555-0123;A=1;a=1", "tel:+1-201-555-0123;a=1;b=2", 0);
+    test_equal("tel:+1-201-555-0123;A=1;b=2", "tel:+1-201-555-0123;a=1;b=2", 1);
+    test_equal("tel:+1234567890;foo=bar", "tel:+1234567890;foo=bar;baz=qux", 0);
+    test_equal("tel:+1234567890;foo=bar", "tel:+1234567890;foo=baz", 0);
+    test_equal("tel:+1234567890;foo", "tel:+1234567890;foo=bar", 0);
+    test_equal("tel:+1234567890;foo=1-2", "tel:+1234567890;foo=12", 0);
+    test_equal("tel:1234567890;phone-context=+1234567890", "tel:+1234567890", 0);
+    test_equal("tel:+1234567890;npdi;rn=+1-202-544", "tel:+1234567890;RN=+1202544;NPDI", 1);
+    test_equal("tel:+1234567890;npdi;rn=+1-202-544", "tel:+1234567890;rn=+1202544", 0);
+    test_equal("tel:+1 800 555 5555", "tel:+1 800 555 5555", 0);
+
+    /* Error reporting */
+    test_error("tel:+1-201-555-0123;ext=1", 0, NULL);
+    test_error("fax:+1-201-555-0123", 0, "scheme");
+    test_error("tel+1-201-555-0123", 3, "scheme");
+    test_error("tel:", 4, "number");
+    test_error("tel:+-", 4, "number");
+    test_error("tel:+1-201-555-0123;ext=1;foo=bar;ext=2", 33, "parameters");
+    test_error("tel:+1-201-555-0123;a=1;b=2;a=3", 27, "parameters");
+    test_error("tel:+1-201-555-0123;A=1;a=1", 23, "parameters");
+    test_error("tel:+1-201-555-0123;EXT=1;ext=2", 25, "parameters");
+    test_error("tel:+1-201-555-0123;phone-context=example.com", 19, "parameters");
+    test_error("tel:7042;ext=1", 14, "parameters");
+    test_error("tel:+1-201-555-0123 ", 19, "end");
+    test_error("tel:+1-201-555-0123;ext=1x", 25, "end");
+
+    /* Events */
+    test_events("tel:+1-201-555-0123", "number=+1-201-555-0123");
+    test_events("tel:7042;phone-context=example.com;npdi;ext=12",
+                "number=7042 name=phone-context value=example.com name=npdi name=ext value=12");
+    test_events("tel:+1-201-555-0123;a=1;b;isub=%20x", "number=+1-201-555-0123 name=a value=1 name=b name=isub value=%20x");
+    test_events("tel:7042", NULL);
+    test_events("tel:+1-201-555-0123;ext=1;ext=2", NULL);
+
+    /* Validation only */
+    test_valid("tel:+1-201-555-0123");
+    test_valid("tel:+-");
+    test_valid("tel:7042");
+    test_valid("tel:7042;phone-context=example.com");
+    test_valid("tel:+1-201-555-0123;ext=1;ext=2");
+    test_valid("tel:+1-201-555-0123-4567-8901-2345 ");
+    test_valid_long("tel:+1;x=", 1100, 'a', "", 1);
+    test_valid_long("tel:+1;isub=", 3000, '/', ";ext=1", 1);
+    test_valid_long("tel:7042;phone-context=", 2000, 'a', ".example.com", 1);
+    test_valid_long("tel:+1-", 3000, '5', "", 1);
+    test_valid_long("tel:+1;x=", 3000, 'a', " ", 0);
+    test_valid_random(20000);
+
+    /* Metrics */
+    metrics_enable(1);
+    test_reason("tel:+1-201-555-0123", -1);
+    test_reason("tel:7042;phone-context=example.com", -1);
+    test_reason("fax:+1-201-555-0123", METRICS_FAIL_SCHEME);
+    test_reason("tel:-", METRICS_FAIL_NUMBER);
+    test_reason("tel:7042", METRICS_FAIL_PARAMETERS);
+    test_reason("tel:+1-201-555-0123;ext=1;ext=2", METRICS_FAIL_PARAMETERS);
+    test_reason("tel:+1-201-555-0123 ", METRICS_FAIL_END);
+    metrics_enable(0);
+
     printf("Total failures: %d\n", failures);
     return 0;
 }
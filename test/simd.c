@@ -0,0 +1,143 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "simd.h"
+#include "rfc_3986.h"
+#include "../src/simd_kernels.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define ASSERT(e) do { if (!(e)) { printf("Assert failed on line %d. Expected: %s\n", __LINE__, #e); failures++; } } while(0)
+
+static unsigned long state = 88172645463325252UL;
+
+/* xorshift, so failures can be reproduced */
+static unsigned long next_rand(void)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static const char *names[] = {
+    "find_non_uri_char", "find_tail_special", "find_non_ascii",
+    "find_idna_special", "find_digit", "find_run_end"
+};
+
+static simd_scan scan_of(const simd_kernels *k, size_t i)
+{
+    switch (i) {
+    case 0: return k->find_non_uri_char;
+    case 1: return k->find_tail_special;
+    case 2: return k->find_non_ascii;
+    case 3: return k->find_idna_special;
+    case 4: return k->find_digit;
+    default: return k->find_run_end;
+    }
+}
+
+/* Each scan of the level has to agree with the scalar one on random
+ * spans, at every alignment and length around the vector widths.  The
+ * bytes past the end would all match, so reading them would show. */
+void test_level(simd_level level, int count)
+{
+    static const char bytes[] = "aaaaaaaaaaaaaaaa0123456789+-.() %#[]\"<>\\^`{|}\x01\x7f\x80\xc3\xff";
+    char buf[512];
+    int i = 0;
+    if (!simd_set_level(level)) {
+        printf("Skipping %s, not supported here\n", simd_level_name(level));
+        return;
+    }
+    ASSERT(simd_get_level() == level);
+    for (i = 0; i < count; i++) {
+        size_t offset = next_rand() % 64;
+        size_t len = next_rand() % 300;
+        size_t rare = 1 + next_rand() % 64;
+        const char *p = &buf[offset];
+        const char *end = p + len;
+        size_t j = 0;
+        for (j = 0; j < offset + len; j++) {
+            /* Mostly letters, with a few of everything else */
+            buf[j] = next_rand() % rare == 0 ? bytes[next_rand() % (sizeof(bytes) - 1)] : 'a';
+        }
+        memset(&buf[offset + len], '%', 8);
+        buf[offset + len + 1] = '\x80';
+        buf[offset + len + 2] = '-';
+        for (j = 0; j < sizeof(names) / sizeof(names[0]); j++) {
+            const char *found = scan_of(&simd_active, j)(p, end);
+            const char *wanted = scan_of(&simd_kernels_scalar, j)(p, end);
+            if (found != wanted) {
+                printf("Failed for %s %s on \"%.*s\"\n", simd_level_name(level), names[j], (int)len, p);
+                printf("Expected - %d\n", (int)(wanted - p));
+                printf("Output   - %d\n", (int)(found - p));
+                failures++;
+                return;
+            }
+        }
+    }
+}
+
+int main()
+{
+    static const char valid[] = "http://example.com/a/path/long/enough/for/every/vector/width?q=1#%41";
+    static const char invalid[] = "http://example.com/a/path/long/enough/for/every/vector/width?q=1#{}";
+    simd_level start = simd_get_level();
+    int level = 0;
+
+    /* The level picked at load is the best one supported */
+    ASSERT(simd_supported(SIMD_SCALAR));
+    ASSERT(simd_supported(start));
+#ifndef URI_SIMD_FORCE
+    for (level = start + 1; level < SIMD_LEVELS; level++) {
+        ASSERT(!simd_supported((simd_level)level));
+    }
+#endif
+    ASSERT(strcmp(simd_level_name(SIMD_AVX2), "avx2") == 0);
+    ASSERT(simd_level_name(SIMD_LEVELS) == NULL);
+    ASSERT(!simd_set_level(SIMD_LEVELS));
+    ASSERT(simd_get_level() == start);
+
+    for (level = SIMD_SCALAR; level < SIMD_LEVELS; level++) {
+        test_level((simd_level)level, 200000);
+        /* and the grammar runs the same on top of it */
+        ASSERT(is_valid_URI(valid, strlen(valid)));
+        ASSERT(!is_valid_URI(invalid, strlen(invalid)));
+    }
+    simd_set_level(start);
+
+    printf("Total failures: %d\n", failures);
+    return 0;
+}
@@ -0,0 +1,132 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rfc_3966.h"
+#include "tel_prefix.h"
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#define TABLE_SIZE 256
+
+static int failures = 0;
+
+static tel_prefix_node nodes[TABLE_SIZE];
+static unsigned int values[TABLE_SIZE];
+
+#define ASSERT(e) do { if (!(e)) { printf("Assert failed on line %d. Expected: %s\n", __LINE__, #e); failures++; } } while(0)
+
+void test_lookup(const tel_prefix_table *t, char *p_url, unsigned int p_value)
+{
+    Tel result = parse_telephone(p_url);
+    unsigned int value = tel_prefix_lookup(t, &result);
+    unsigned int batched = 0;
+    tel_prefix_lookup_n(t, &result, 1, &batched);
+    if (value != p_value || batched != p_value) {
+        printf("Failed for URI: %s\n", p_url);
+        printf("Expected - value: %u\n", p_value);
+        printf("Output   - value: %u, batched: %u\n", value, batched);
+        failures++;
+    }
+}
+
+int main()
+{
+    tel_prefix_table t;
+    tel_prefix_init(&t, nodes, values, TABLE_SIZE);
+
+    /* Building */
+    ASSERT(tel_prefix_insert(&t, "+1", 2, 1));
+    ASSERT(tel_prefix_insert(&t, "+1-800", 6, 2));
+    ASSERT(tel_prefix_insert(&t, "+1-800-555", 10, 3));
+    ASSERT(tel_prefix_insert(&t, "+44", 3, 4));
+    ASSERT(tel_prefix_insert(&t, "+44(20)", 7, 5));
+    ASSERT(tel_prefix_insert(&t, "+81.3", 5, 6));
+    ASSERT(tel_prefix_insert(&t, "4420", 4, 7) == 0); /* duplicate of +44(20) */
+    ASSERT(tel_prefix_insert(&t, "+33", 3, 0) == 0);  /* 0 means no match */
+    ASSERT(tel_prefix_insert(&t, "+", 1, 8) == 0);    /* no digits */
+    ASSERT(tel_prefix_insert(&t, "+3 3", 4, 8) == 0); /* not a separator */
+    ASSERT(tel_prefix_insert(&t, "+49", 2, 9));       /* length is respected */
+
+    /* Longest match wins */
+    test_lookup(&t, "tel:+1-212-555-1212", 1);
+    test_lookup(&t, "tel:+1-800-123-4567", 2);
+    test_lookup(&t, "tel:+1-800-555-0199", 3);
+    test_lookup(&t, "tel:+1(800)5550199;ext=12", 3);
+    test_lookup(&t, "tel:+44-20-7946-0958", 5);
+    test_lookup(&t, "tel:+44.161.496.0000", 4);
+    test_lookup(&t, "tel:+81-3-1234-5678", 6);
+    test_lookup(&t, "tel:+4-9", 9);
+    /* Partial prefixes don't count */
+    test_lookup(&t, "tel:+8", 0);
+    test_lookup(&t, "tel:+81-6-1234-5678", 0);
+    test_lookup(&t, "tel:+33-1-555-9999", 0);
+    /* Local numbers have no global number */
+    test_lookup(&t, "tel:1234567890;phone-context=+1-800", 0);
+    /* Neither do invalid ones */
+    test_lookup(&t, "tel:+1 800 555 5555", 0);
+
+    /* Batches of more than one round */
+    {
+        const char *urls[] = {
+            "tel:+1-800-555-0199", "tel:+44-20-7946-0958", "tel:+8",
+            "tel:+1-212-555-1212", "tel:555-1234;phone-context=+1-800",
+            "tel:+81-3-1234-5678", "tel:+44.161.496.0000", "tel:+1-800-123",
+            "tel:+49-30-123456", "tel:+33-1-555-9999", "tel:+1",
+        };
+        unsigned int expected[] = { 3, 5, 0, 1, 0, 6, 4, 2, 9, 0, 1 };
+        Tel tels[sizeof(urls) / sizeof(urls[0])];
+        unsigned int got[sizeof(urls) / sizeof(urls[0])];
+        size_t n = sizeof(urls) / sizeof(urls[0]);
+        size_t i = 0;
+        for (i = 0; i < n; i++) {
+            tels[i] = parse_telephone(urls[i]);
+        }
+        tel_prefix_lookup_n(&t, tels, n, got);
+        for (i = 0; i < n; i++) {
+            ASSERT(got[i] == expected[i]);
+        }
+    }
+
+    /* Running out of nodes */
+    {
+        tel_prefix_table small;
+        tel_prefix_init(&small, nodes, values, 4);
+        ASSERT(tel_prefix_insert(&small, "+123", 4, 1));
+        ASSERT(tel_prefix_insert(&small, "+1234", 5, 2) == 0);
+        ASSERT(tel_prefix_insert(&small, "+12", 3, 3));
+    }
+
+    printf("Total failures: %d\n", failures);
+    return 0;
+}
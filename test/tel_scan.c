@@ -0,0 +1,117 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tel_scan.h"
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#define MAX_MATCHES 8
+
+static int failures = 0;
+
+/* Expected is a list of alternating spans and URIs, ending in NULL */
+void test_scan(char *p_text, char *p_context, unsigned int p_min_digits, char **p_expected)
+{
+    tel_match matches[MAX_MATCHES];
+    char buf[1024];
+    size_t n = scan_telephone(p_text, strlen(p_text), p_context, p_min_digits,
+                              matches, MAX_MATCHES, buf, sizeof(buf));
+    size_t i = 0;
+    int ok = 1;
+    for (i = 0; i < n; i++) {
+        size_t span_len = matches[i].stop - matches[i].start;
+        if (p_expected[2 * i] == NULL ||
+            span_len != strlen(p_expected[2 * i]) ||
+            strncmp(matches[i].start, p_expected[2 * i], span_len) != 0 ||
+            strcmp(matches[i].uri, p_expected[2 * i + 1]) != 0) {
+            ok = 0;
+        }
+    }
+    if (!ok || p_expected[2 * n] != NULL) {
+        printf("Failed for text: %s\n", p_text);
+        printf("Expected -");
+        for (i = 0; p_expected[i] != NULL; i += 2) {
+            printf(" [%s %s]", p_expected[i], p_expected[i + 1]);
+        }
+        printf("\nOutput   -");
+        for (i = 0; i < n; i++) {
+            printf(" [%.*s %s]", (int)(matches[i].stop - matches[i].start), matches[i].start, matches[i].uri);
+        }
+        printf("\n");
+        failures++;
+    }
+}
+
+int main()
+{
+    {
+        char *e[] = { "+1 (415) 555-2671", "tel:+1-(415)-555-2671", NULL };
+        test_scan("Please call +1 (415) 555-2671 after 5pm.", NULL, 7, e);
+    }
+    {
+        char *e[] = { "+44.20.7946.0958", "tel:+44.20.7946.0958",
+                      "+81-3-1234-5678", "tel:+81-3-1234-5678", NULL };
+        test_scan("London: +44.20.7946.0958, Tokyo: +81-3-1234-5678.", NULL, 7, e);
+    }
+    {
+        /* local numbers need a context */
+        char *none[] = { NULL };
+        char *e[] = { "(212) 555-1212", "tel:(212)-555-1212;phone-context=+1", NULL };
+        test_scan("Office (212) 555-1212 ext. 4", NULL, 7, none);
+        test_scan("Office (212) 555-1212 ext. 4", "+1", 7, e);
+    }
+    {
+        /* too short, or part of a word */
+        char *none[] = { NULL };
+        test_scan("Order 1234 shipped on 5/6", "+1", 7, none);
+        test_scan("Ref ABC5551234567 or 5551234567XYZ", "+1", 7, none);
+        test_scan("", "+1", 7, none);
+        test_scan("no digits anywhere in this rather long line of text at all", "+1", 7, none);
+    }
+    {
+        /* a second "+" starts another number */
+        char *e[] = { "+1-800-555-0199", "tel:+1-800-555-0199",
+                      "+1-800-555-0100", "tel:+1-800-555-0100", NULL };
+        test_scan("+1-800-555-0199 +1-800-555-0100", NULL, 7, e);
+    }
+    {
+        /* numbers at the very edges of the text, past a 16 byte block */
+        char *e[] = { "5551234567", "tel:5551234567;phone-context=example.com",
+                      "5557654321", "tel:5557654321;phone-context=example.com", NULL };
+        test_scan("5551234567 then some padding text to cross blocks 5557654321", "example.com", 7, e);
+    }
+
+    printf("Total failures: %d\n", failures);
+    return 0;
+}
@@ -0,0 +1,368 @@
+/* URIPathFinder: A simple parser for URIs
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2024, Nate Bragg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* tel_normalize: bulk normalization of telephone numbers
+ *
+ * Reads a newline delimited file, optionally CSV, where one column
+ * holds a tel URI or a raw number, and writes one CSV row per line:
+ *
+ *     input,e164,extension,valid
+ *
+ * Raw numbers may be grouped with spaces, which are read as "-".  The
+ * input column is written quoted, with any quotes in it doubled.  The
+ * E.164 column is empty for valid numbers that have no E.164 form,
+ * e.g., a local number whose phone-context is a domain name.
+ *
+ * The input is mapped into memory and split into chunks on line
+ * boundaries, which are parsed in parallel with parse_telephone and
+ * written out in the original order.  Throughput and the number of
+ * invalid rows are reported on stderr. */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "rfc_3966.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_FIELD 1024
+#define MAX_THREADS 256
+/* Each thread gets this much input per round, so the output buffers
+   stay bounded no matter how large the input is */
+#define CHUNK_SIZE (16 * 1024 * 1024)
+
+typedef struct options {
+    int column;
+    int threads;
+    const char *context;
+    const char *input;
+    const char *output;
+} options;
+
+typedef struct job {
+    const options *opts;
+    const char *start;
+    const char *stop;
+    char *out;
+    size_t out_len;
+    size_t out_size;
+    size_t rows;
+    size_t errors;
+} job;
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-c column] [-j threads] [-p phone-context] [-o output] input\n"
+                    "  -c  zero based CSV column holding the number (default 0)\n"
+                    "  -j  number of threads (default: online CPUs)\n"
+                    "  -p  phone-context for raw numbers without a leading +\n"
+                    "  -o  output file (default: stdout)\n", name);
+}
+
+static int parse_options(int argc, char **argv, options *opts) {
+    int c = 0;
+    opts->column = 0;
+    opts->threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    opts->context = NULL;
+    opts->output = NULL;
+    while ((c = getopt(argc, argv, "c:j:p:o:")) != -1) {
+        switch (c) {
+        case 'c': opts->column = atoi(optarg); break;
+        case 'j': opts->threads = atoi(optarg); break;
+        case 'p': opts->context = optarg; break;
+        case 'o': opts->output = optarg; break;
+        default: return 0;
+        }
+    }
+    if (optind + 1 != argc || opts->column < 0) {
+        return 0;
+    }
+    if (opts->threads < 1) {
+        opts->threads = 1;
+    } else if (opts->threads > MAX_THREADS) {
+        opts->threads = MAX_THREADS;
+    }
+    opts->input = argv[optind];
+    return 1;
+}
+
+static void emit(job *j, const char *s, size_t len) {
+    if (j->out_len + len > j->out_size) {
+        size_t size = j->out_size ? j->out_size : 4096;
+        while (j->out_len + len > size) {
+            size *= 2;
+        }
+        j->out = realloc(j->out, size);
+        if (j->out == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+        j->out_size = size;
+    }
+    memcpy(&j->out[j->out_len], s, len);
+    j->out_len += len;
+}
+
+/* Append the digits in [p, stop), dropping "+" and visual separators */
+static size_t copy_digits(char *buf, const char *p, const char *stop) {
+    size_t len = 0;
+    for (; p < stop; p++) {
+        if (*p >= '0' && *p <= '9') {
+            buf[len++] = *p;
+        } else if (*p != '+' && *p != '-' && *p != '.' && *p != '(' && *p != ')') {
+            /* Hex digits, * or # have no E.164 form */
+            return 0;
+        }
+    }
+    return len;
+}
+
+/* Find the given CSV column in the line, handling simple quoting */
+static int find_column(const char *line, const char *eol, int column, const char **start, const char **stop) {
+    const char *p = line;
+    int i = 0;
+    for (i = 0; p <= eol; i++) {
+        const char *field = p;
+        const char *field_stop = NULL;
+        if (p < eol && *p == '"') {
+            field = ++p;
+            for (; p < eol && *p != '"'; p++);
+            field_stop = p;
+            for (; p < eol && *p != ','; p++);
+        } else {
+            for (; p < eol && *p != ','; p++);
+            field_stop = p;
+        }
+        if (i == column) {
+            *start = field;
+            *stop = field_stop;
+            return 1;
+        }
+        p++;
+    }
+    return 0;
+}
+
+static void normalize_line(job *j, const char *line, const char *eol) {
+    static const char tel[] = "tel:";
+    char uri[MAX_FIELD + sizeof(tel) + 64];
+    char e164[2 * MAX_FIELD + 2];
+    char ext[MAX_FIELD];
+    size_t e164_len = 0;
+    size_t ext_len = 0;
+    size_t uri_len = 0;
+    int raw = 0;
+    const char *field = NULL;
+    const char *field_stop = NULL;
+    int valid = 0;
+    Tel t;
+
+    if (eol > line && eol[-1] == '\r') {
+        eol--;
+    }
+    if (!find_column(line, eol, j->opts->column, &field, &field_stop)) {
+        field = field_stop = eol;
+    }
+    if ((size_t)(field_stop - field) <= MAX_FIELD) {
+        /* Raw numbers get the scheme and, if local, the configured context */
+        raw = (size_t)(field_stop - field) < sizeof(tel) - 1 ||
+              strncmp(field, tel, sizeof(tel) - 1) != 0;
+        if (raw) {
+            memcpy(uri, tel, sizeof(tel) - 1);
+            uri_len = sizeof(tel) - 1;
+        }
+        memcpy(&uri[uri_len], field, field_stop - field);
+        if (raw) {
+            /* Spaces group the digits of raw numbers, as "-" does in a
+               tel URI, the same as scan_telephone writes them */
+            char *p = &uri[uri_len];
+            while ((p = memchr(p, ' ', &uri[uri_len] + (field_stop - field) - p)) != NULL) {
+                *p++ = '-';
+            }
+        }
+        uri_len += field_stop - field;
+        if (raw && field < field_stop && *field != '+' && j->opts->context != NULL &&
+            memchr(field, ';', field_stop - field) == NULL &&
+            strlen(j->opts->context) < 48) {
+            uri_len += sprintf(&uri[uri_len], ";phone-context=%s", j->opts->context);
+        }
+        uri[uri_len] = '\0';
+
+        t = parse_telephone(uri);
+        if (t.global_number != NULL) {
+            e164[0] = '+';
+            e164_len = copy_digits(&e164[1], t.global_number, t.number_stop);
+            e164_len = e164_len ? e164_len + 1 : 0;
+        } else if (t.local_number != NULL && t.pars.context[15] == '+') {
+            /* A global phone-context is the prefix of the local number;
+               ";phone-context=" is 15 characters */
+            size_t prefix = 0;
+            e164[0] = '+';
+            prefix = copy_digits(&e164[1], &t.pars.context[15], t.pars.context_stop);
+            e164_len = prefix ? copy_digits(&e164[prefix + 1], t.local_number, t.number_stop) : 0;
+            e164_len = e164_len ? e164_len + prefix + 1 : 0;
+        }
+        if (t.pars.ext != NULL) {
+            /* ";ext=" is 5 characters */
+            ext_len = copy_digits(ext, &t.pars.ext[5], t.pars.ext_stop);
+        }
+        valid = t.global_number != NULL || t.local_number != NULL;
+    }
+
+    j->rows++;
+    j->errors += !valid;
+    emit(j, "\"", 1);
+    /* Quotes in the input are doubled, so the column stays one field */
+    while (field < field_stop) {
+        const char *quote = memchr(field, '"', field_stop - field);
+        const char *stop = quote != NULL ? quote + 1 : field_stop;
+        emit(j, field, stop - field);
+        if (quote != NULL) {
+            emit(j, "\"", 1);
+        }
+        field = stop;
+    }
+    emit(j, "\",", 2);
+    emit(j, e164, e164_len);
+    emit(j, ",", 1);
+    emit(j, ext, ext_len);
+    emit(j, valid ? ",1\n" : ",0\n", 3);
+}
+
+static void *normalize(void *arg) {
+    job *j = (job *)arg;
+    const char *line = j->start;
+    while (line < j->stop) {
+        const char *eol = memchr(line, '\n', j->stop - line);
+        if (eol == NULL) {
+            eol = j->stop;
+        }
+        if (eol > line) {
+            normalize_line(j, line, eol);
+        }
+        line = eol + 1;
+    }
+    return NULL;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    options opts;
+    pthread_t threads[MAX_THREADS];
+    job jobs[MAX_THREADS];
+    struct stat st;
+    const char *data = NULL;
+    const char *p = NULL;
+    const char *end = NULL;
+    FILE *out = stdout;
+    size_t rows = 0;
+    size_t errors = 0;
+    double start = 0;
+    double elapsed = 0;
+    int fd = -1;
+    int i = 0;
+
+    if (!parse_options(argc, argv, &opts)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if ((fd = open(opts.input, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+        perror(opts.input);
+        return 1;
+    }
+    if (opts.output != NULL && (out = fopen(opts.output, "w")) == NULL) {
+        perror(opts.output);
+        return 1;
+    }
+    if (st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            perror("mmap");
+            return 1;
+        }
+        posix_madvise((void *)data, st.st_size, POSIX_MADV_SEQUENTIAL);
+    }
+    memset(jobs, 0, sizeof(jobs));
+
+    start = now();
+    p = data;
+    end = data + st.st_size;
+    while (p < end) {
+        int n = 0;
+        /* Hand each thread a chunk that ends on a line boundary */
+        for (n = 0; n < opts.threads && p < end; n++) {
+            const char *stop = (size_t)(end - p) > CHUNK_SIZE ? p + CHUNK_SIZE : end;
+            const char *eol = stop < end ? memchr(stop, '\n', end - stop) : NULL;
+            stop = eol ? eol + 1 : end;
+            jobs[n].opts = &opts;
+            jobs[n].start = p;
+            jobs[n].stop = stop;
+            jobs[n].out_len = 0;
+            if (pthread_create(&threads[n], NULL, normalize, &jobs[n]) != 0) {
+                perror("pthread_create");
+                return 1;
+            }
+            p = stop;
+        }
+        for (i = 0; i < n; i++) {
+            pthread_join(threads[i], NULL);
+            fwrite(jobs[i].out, 1, jobs[i].out_len, out);
+        }
+    }
+    fflush(out);
+    elapsed = now() - start;
+
+    for (i = 0; i < opts.threads; i++) {
+        rows += jobs[i].rows;
+        errors += jobs[i].errors;
+        free(jobs[i].out);
+    }
+    fprintf(stderr, "rows: %lu, errors: %lu, seconds: %.3f, rows/s: %.0f, MB/s: %.1f\n",
+            (unsigned long)rows, (unsigned long)errors, elapsed,
+            elapsed > 0 ? rows / elapsed : 0,
+            elapsed > 0 ? st.st_size / elapsed / 1e6 : 0);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}